@@ -36,3 +36,11 @@ typename T::mapped_type get(T const& map, typename T::key_type const& key)
     typename T::const_iterator iter(map.find(key));
     return iter != map.end() ? iter->second : typename T::mapped_type();
 }
+
+/**
+ * Compares two wrapping sequence numbers, returns true if a is newer than b.
+ */
+inline bool isNewer(uint32_t a, uint32_t b)
+{
+    return int32_t(a - b) > 0;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Common.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+
+#include <enet/enet.h>
+
+const uint8_t RELIABLE_CHANNEL = 0;
+const uint8_t UNRELIABLE_CHANNEL = 1;
+const uint8_t SEQUENCED_CHANNEL = 2;
+const uint8_t NUM_CHANNELS = 3;
+
+/**
+ * Get the ENet channel and packet flags for a delivery type.
+ */
+void getChannel(DeliveryType, uint8_t&, uint32_t&);
+
+/**
+ * Create a packet that references the serialized bytes of a message rather
+ * than copying them. The message is kept alive until ENet destroys the
+ * packet.
+ */
+ENetPacket* createPacket(const Message::Shared&, uint32_t);
@@ -1,23 +1,34 @@
 #pragma once
 
+#include "enet/PacketCompressor.h"
+#include "enet/PeerMonitor.h"
 #include "net/Client.h"
+#include "net/Compression.h"
 #include "net/DeliveryType.h"
 #include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
+#include "net/SPSCQueue.h"
 
 #include <enet/enet.h>
 
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 class ENetClient : public Client {
 
 public:
     typedef std::shared_ptr<ENetClient> Shared;
-    static Shared alloc();
+    // NOTE: in threaded mode a dedicated thread owns the host and services it
+    // while connected, all other methods must be called from a single thread
+    static Shared alloc(bool threaded = false);
 
-    ENetClient();
+    explicit ENetClient(bool threaded = false);
     ~ENetClient();
 
     bool connect(const std::string&, uint32_t);
@@ -25,16 +36,45 @@ public:
     bool isConnected() const;
 
     void send(DeliveryType, StreamBuffer::Shared) const;
-    Message::Shared request(uint32_t, StreamBuffer::Shared);
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
     std::vector<Message::Shared> poll();
 
     void on(uint32_t, RequestHandler);
 
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    PeerStats stats() const;
+
 private:
+    // an outbound message for the network thread, a null message is a flush
+    struct Outbound {
+        Outbound()
+            : type(DeliveryType::RELIABLE)
+        {
+        }
+        Outbound(DeliveryType type, Message::Shared msg)
+            : type(type)
+            , msg(msg)
+        {
+        }
+        DeliveryType type;
+        Message::Shared msg;
+    };
+
     void sendMessage(DeliveryType type, Message::Shared msg) const;
-    void sendRequest(uint32_t responseId, StreamBuffer::Shared stream) const;
+    void writeMessage(DeliveryType type, Message::Shared msg) const;
+    void enqueue(const Outbound&) const;
+    void service(std::vector<Message::Shared>&, uint32_t timeout);
+    std::vector<Message::Shared> dispatch(const std::vector<Message::Shared>&);
+    void run();
+    void stopThread();
+    void sampleStats(std::time_t now);
+    uint32_t sendRequest(uint32_t requestId, StreamBuffer::Shared stream) const;
     void sendResponse(uint32_t requestId, StreamBuffer::Shared stream) const;
-    void handleRequest(uint32_t, StreamBuffer::Shared stream) const;
+    void handleRequest(const Message::Shared&) const;
 
     // prevent copy-construction
     ENetClient(const ENetClient&);
@@ -43,7 +83,29 @@ private:
 
     ENetHost* host_;
     ENetPeer* server_;
-    std::vector<Message::Shared> queue_;
     std::map<uint32_t, RequestHandler> handlers_;
+    RequestTable::Shared requests_;
+    PacketCompressor::Shared compressor_;
     mutable uint32_t currentMsgId_;
+    mutable uint32_t numQueued_;
+    // id of the newest sequenced message received, if there has been one
+    uint32_t sequence_;
+    bool hasSequence_;
+    bool threaded_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<bool> connected_;
+    // datagrams sent by the network thread since the last flush
+    std::atomic<uint32_t> numSent_;
+    SPSCQueue<Message::Shared> inbound_;
+    mutable SPSCQueue<Outbound> outbound_;
+    // messages popped by the network thread, held until the next flush
+    std::vector<Outbound> staged_;
+    // mutable so that sends can update the statistics
+    mutable PeerMonitor monitor_;
+    // statistics of the connection as of the last sample, guarded by the
+    // mutex as they are sampled by the network thread
+    mutable std::mutex statsMutex_;
+    PeerStats stats_;
+    std::time_t lastSample_;
 };
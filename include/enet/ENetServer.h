@@ -1,26 +1,38 @@
 #pragma once
 
+#include "enet/PacketCompressor.h"
+#include "enet/PeerMonitor.h"
+#include "net/Compression.h"
 #include "net/DeliveryType.h"
 #include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
+#include "net/SPSCQueue.h"
 #include "net/Server.h"
 
 #include <enet/enet.h>
 
+#include <atomic>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 class ENetServer : public Server {
 
 public:
     typedef std::shared_ptr<ENetServer> Shared;
-    static Shared alloc();
+    // NOTE: in threaded mode a dedicated thread owns the host and services it
+    // continuously, all other methods must be called from a single thread.
+    // The id offset is added to the ENet peer id to get the client id.
+    static Shared alloc(bool threaded = false, uint32_t idOffset = 0);
 
-    ENetServer();
+    explicit ENetServer(bool threaded = false, uint32_t idOffset = 0);
     ~ENetServer();
 
-    bool start(uint32_t);
+    bool start(uint32_t, uint32_t = DEFAULT_MAX_CONNECTIONS);
     bool stop();
     bool isRunning() const;
 
@@ -28,16 +40,75 @@ public:
 
     void send(uint32_t, DeliveryType, StreamBuffer::Shared) const;
     void broadcast(DeliveryType, StreamBuffer::Shared) const;
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
     std::vector<Message::Shared> poll();
 
     void on(uint32_t, RequestHandler);
 
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    std::vector<PeerStats> stats() const;
+
 private:
+    // an outbound message for the network thread, a null message is a flush
+    struct Outbound {
+        Outbound()
+            : id(0)
+            , broadcast(false)
+            , type(DeliveryType::RELIABLE)
+        {
+        }
+        Outbound(uint32_t id, bool broadcast, DeliveryType type, Message::Shared msg)
+            : id(id)
+            , broadcast(broadcast)
+            , type(type)
+            , msg(msg)
+        {
+        }
+        uint32_t id;
+        bool broadcast;
+        DeliveryType type;
+        Message::Shared msg;
+    };
+
+    // state for a single connection
+    struct PeerEntry {
+        PeerEntry()
+            : peer(nullptr)
+            , sequence(0)
+            , hasSequence(false)
+        {
+        }
+        // nullptr if the slot is free
+        ENetPeer* peer;
+        // id of the newest sequenced message received
+        uint32_t sequence;
+        bool hasSequence;
+        PeerMonitor monitor;
+        // messages popped by the network thread, held until the next flush
+        std::vector<Outbound> staged;
+    };
+
     ENetPeer* getClient(uint32_t) const;
+    bool addPeer(ENetPeer*);
+    bool removePeer(ENetPeer*);
     void sendMessage(uint32_t id, DeliveryType type, Message::Shared msg) const;
     void broadcastMessage(DeliveryType type, Message::Shared msg) const;
+    void writeMessage(uint32_t id, DeliveryType type, Message::Shared msg) const;
+    void writeBroadcast(DeliveryType type, Message::Shared msg) const;
+    void enqueue(const Outbound&) const;
+    void stage(const Outbound&);
+    void writeStaged();
+    void service(std::vector<Message::Shared>&, uint32_t timeout);
+    std::vector<Message::Shared> dispatch(const std::vector<Message::Shared>&);
+    void run();
+    void sampleStats(std::time_t now);
+    uint32_t sendRequest(uint32_t, uint32_t requestId, StreamBuffer::Shared stream) const;
     void sendResponse(uint32_t, uint32_t requestId, StreamBuffer::Shared stream) const;
-    void handleRequest(uint32_t, uint32_t, StreamBuffer::Shared stream) const;
+    void handleRequest(const Message::Shared&) const;
 
     // prevent copy-construction
     ENetServer(const ENetServer&);
@@ -46,12 +117,29 @@ private:
 
     ENetHost* host_;
     // NOTE: ENet allocates all peers at once and doesn't shuffle them,
-    // which leads to non-contiguous connected peers. This map
-    // will make it easier to manage them by id
-    std::map<uint32_t, ENetPeer*> clients_;
-    std::vector<Message::Shared> queue_;
+    // which leads to non-contiguous connected peers. This table is indexed by
+    // the incoming peer id, free slots have no peer. Mutable so that sends
+    // can update the statistics
+    mutable std::vector<PeerEntry> peers_;
     std::map<uint32_t, RequestHandler> handlers_;
+    RequestTable::Shared requests_;
+    PacketCompressor::Shared compressor_;
     mutable uint32_t currentMsgId_;
+    mutable uint32_t numQueued_;
+    bool threaded_;
+    uint32_t idOffset_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    std::atomic<uint32_t> numClients_;
+    // datagrams sent by the network thread since the last flush
+    std::atomic<uint32_t> numSent_;
+    SPSCQueue<Message::Shared> inbound_;
+    mutable SPSCQueue<Outbound> outbound_;
+    // statistics of every connected peer as of the last sample, guarded by
+    // the mutex as they are sampled by the network thread
+    mutable std::mutex statsMutex_;
+    std::vector<PeerStats> stats_;
+    std::time_t lastSample_;
 };
 
 std::string addressToString(const ENetAddress* address);
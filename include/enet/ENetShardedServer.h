@@ -0,0 +1,61 @@
+#pragma once
+
+#include "enet/ENetServer.h"
+#include "net/Compression.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/Server.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * Client ids are partitioned by shard, shard N owns the ids in
+ * [N * SHARD_ID_STRIDE, (N + 1) * SHARD_ID_STRIDE).
+ */
+const uint32_t SHARD_ID_STRIDE = MAX_PEER_ID + 1;
+
+/**
+ * Runs several threaded ENet hosts, one per port starting at the given
+ * port, behind a single server. Clients may connect to any of the ports.
+ */
+class ENetShardedServer : public Server {
+
+public:
+    typedef std::shared_ptr<ENetShardedServer> Shared;
+    static Shared alloc(uint32_t numShards);
+
+    explicit ENetShardedServer(uint32_t numShards);
+
+    // NOTE: the connection limit is split evenly across the shards
+    bool start(uint32_t, uint32_t = DEFAULT_MAX_CONNECTIONS);
+    bool stop();
+    bool isRunning() const;
+
+    uint32_t numClients() const;
+
+    void send(uint32_t, DeliveryType, StreamBuffer::Shared) const;
+    void broadcast(DeliveryType, StreamBuffer::Shared) const;
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
+    std::vector<Message::Shared> poll();
+
+    void on(uint32_t, RequestHandler);
+
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    std::vector<PeerStats> stats() const;
+
+private:
+    // prevent copy-construction
+    ENetShardedServer(const ENetShardedServer&);
+    // prevent assignment
+    ENetShardedServer& operator=(const ENetShardedServer&);
+
+    ENetServer::Shared shard(uint32_t) const;
+
+    std::vector<ENetServer::Shared> shards_;
+};
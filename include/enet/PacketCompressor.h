@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Common.h"
+#include "net/Compression.h"
+
+#include <enet/enet.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * Compresses the datagrams of an ENet host with the selected codec. Each
+ * compressed datagram starts with a byte identifying its codec, so any
+ * compressor can decompress the output of any other.
+ */
+class PacketCompressor {
+
+public:
+    typedef std::shared_ptr<PacketCompressor> Shared;
+    static Shared alloc(Compression);
+
+    explicit PacketCompressor(Compression);
+    ~PacketCompressor();
+
+    // NOTE: the compressor must outlive the host
+    void install(ENetHost*);
+
+    Compression type() const;
+    CompressionStats stats() const;
+
+    // bitmask of the codecs that can be decompressed, exchanged on connect
+    static uint32_t supported();
+    static bool supports(uint32_t, Compression);
+
+private:
+    // prevent copy-construction
+    PacketCompressor(const PacketCompressor&);
+    // prevent assignment
+    PacketCompressor& operator=(const PacketCompressor&);
+
+    static size_t ENET_CALLBACK compress(void*, const ENetBuffer*, size_t, size_t, enet_uint8*, size_t);
+    static size_t ENET_CALLBACK decompress(void*, const enet_uint8*, size_t, enet_uint8*, size_t);
+
+    size_t compressDatagram(const ENetBuffer*, size_t, size_t, uint8_t*, size_t);
+    size_t decompressDatagram(const uint8_t*, size_t, uint8_t*, size_t);
+
+    Compression type_;
+    void* rangeCoder_;
+    // contiguous copy of the datagram for the adaptive coder
+    std::vector<uint8_t> scratch_;
+    // NOTE: updated by the thread servicing the host
+    std::atomic<uint64_t> datagrams_;
+    std::atomic<uint64_t> bytesIn_;
+    std::atomic<uint64_t> bytesOut_;
+    std::atomic<std::time_t> compressTime_;
+    std::atomic<std::time_t> decompressTime_;
+};
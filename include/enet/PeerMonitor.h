@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Common.h"
+#include "net/PeerStats.h"
+
+#include <enet/enet.h>
+
+#include <ctime>
+
+/**
+ * Counts the traffic of a single ENet peer and periodically combines it with
+ * the peer's own round trip and loss estimates.
+ */
+class PeerMonitor {
+
+public:
+    PeerMonitor();
+
+    void sent(size_t bytes);
+    void received(size_t bytes);
+
+    // reads the peer and computes the rates since the previous sample
+    void sample(uint32_t id, const ENetPeer*, std::time_t now);
+
+    const PeerStats& stats() const;
+
+private:
+    PeerStats stats_;
+    // totals at the previous sample
+    PeerStats last_;
+    std::time_t lastSample_;
+    // ENet's lost packet count at the previous sample
+    uint32_t packetsLost_;
+};
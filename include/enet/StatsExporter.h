@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Common.h"
+#include "net/Compression.h"
+#include "net/PeerStats.h"
+
+#include <enet/enet.h>
+
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Writes connection statistics as JSON, one object per line, to a file or
+ * as one UDP datagram per line to a collector.
+ */
+class StatsExporter {
+
+public:
+    typedef std::shared_ptr<StatsExporter> Shared;
+    static Shared alloc();
+
+    StatsExporter();
+    ~StatsExporter();
+
+    // the target is either `file:PATH` or `udp:HOST:PORT`, returns 0 on
+    // success
+    bool open(const std::string&);
+    void close();
+    bool isOpen() const;
+
+    void write(std::time_t, const std::vector<PeerStats>&);
+    void write(std::time_t, const PeerStats&);
+    void write(std::time_t, const CompressionStats&);
+
+private:
+    // prevent copy-construction
+    StatsExporter(const StatsExporter&);
+    // prevent assignment
+    StatsExporter& operator=(const StatsExporter&);
+
+    void writeLine(const std::string&);
+
+    std::ofstream file_;
+    ENetSocket socket_;
+    ENetAddress address_;
+};
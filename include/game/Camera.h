@@ -1,9 +1,7 @@
 #pragma once
 
 #include "Common.h"
-#include "game/Player.h"
 #include "game/State.h"
-#include "game/StateMachine.h"
 #include "input/Input.h"
 #include "math/Transform.h"
 #include "serial/StreamBuffer.h"
@@ -19,7 +17,8 @@ public:
     Camera(float32_t, Transform::Shared);
 
     void update(std::time_t);
-    void follow(Player::Shared);
+    // eases towards the transform, jumping to it when starting to follow
+    void follow(Transform::Shared);
 
     Transform::Shared transform();
 
@@ -43,7 +42,7 @@ private:
     Camera& operator=(const Camera&);
 
     Transform::Shared transform_;
-    Player::Shared target_;
+    Transform::Shared target_;
     glm::vec3 targetPosition_;
     float32_t distance_;
     float32_t zoomVelocity_;
@@ -52,5 +51,4 @@ private:
     float32_t aspect_;
     float32_t near_;
     float32_t far_;
-    // StateMachine::Shared state_;
 };
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Common.h"
+#include "game/Interest.h"
+#include "game/Snapshot.h"
+#include "game/SnapshotHistory.h"
+#include "geometry/SpatialHash.h"
+#include "net/PeerStats.h"
+#include "serial/StreamBuffer.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * The server's record of what a single client has been sent and what it has
+ * acknowledged, and of the inputs received from it and when it saw the world
+ * it made them in.
+ */
+class ClientView {
+
+public:
+    typedef std::shared_ptr<ClientView> Shared;
+    static Shared alloc(uint32_t, const Interest&);
+
+    ClientView(uint32_t, const Interest&);
+
+    uint32_t id() const;
+
+    void ack(uint32_t);
+    Snapshot::Shared baseline() const;
+
+    // returns true if the input hasn't been received before
+    bool acceptInput(uint32_t);
+    uint32_t inputAck() const;
+    // server time the client was rendering when it sent its newest input
+    void setViewTime(std::time_t);
+    std::time_t viewTime() const;
+
+    void setBudget(uint32_t);
+    uint32_t budget() const;
+    // shrinks the budget while the client's link is congested, recovers it
+    // while it isn't
+    void adaptBudget(const PeerStats&);
+
+    // snapshots per second the client asked for
+    void setSendRate(uint32_t);
+    // the rate it is sent at, lower while it isn't keeping up
+    uint32_t sendRate() const;
+    // whether a snapshot is due, advances the schedule if so
+    bool due(std::time_t);
+    // backs the rate off if acks are lagging, recovers it if not
+    void adaptSendRate();
+
+    // the players of the snapshot worth sending the client, numbered as the
+    // client's next snapshot. The index holds the snapshot's player slots
+    Snapshot::Shared relevant(const Snapshot::Shared&, const SpatialHash::Shared&);
+    StreamBuffer::Shared serialize(const Snapshot::Shared&);
+
+private:
+    // prevent copy-construction
+    ClientView(const ClientView&);
+    // prevent assignment
+    ClientView& operator=(const ClientView&);
+
+    // priority gained by the player at the index of the snapshot, against
+    // the index it was last sent at, -1 if it wasn't
+    float32_t weight(const Snapshot::Shared&, uint32_t, const Snapshot::Shared&, int32_t, const glm::vec3&) const;
+
+    uint32_t id_;
+    Interest interest_;
+    // id of the newest snapshot made for the client
+    uint32_t sequence_;
+    uint32_t acked_;
+    SnapshotHistory::Shared sent_;
+    // sequence number of the newest input received
+    uint32_t inputAck_;
+    std::time_t viewTime_;
+    // bytes of player updates per snapshot
+    uint32_t budget_;
+    // lowest round trip measured, in milliseconds, 0 until there is one
+    uint32_t minRoundTrip_;
+    uint32_t requestedRate_;
+    uint32_t sendRate_;
+    std::time_t nextSend_;
+    // accumulated priority of each relevant player that is waiting for an
+    // update, ordered by id, players are sent once it reaches 1
+    std::vector<std::pair<uint32_t, float32_t> > priorities_;
+    // reused each snapshot to avoid allocating
+    std::vector<std::pair<uint32_t, float32_t> > carried_;
+    std::vector<uint32_t> slots_;
+    std::vector<std::pair<float32_t, uint32_t> > candidates_;
+    // ids of the players sent, and whether with their current state or the
+    // last one sent
+    std::vector<std::pair<uint32_t, bool> > selected_;
+};
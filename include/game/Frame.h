@@ -1,13 +1,27 @@
 #pragma once
 
 #include "Common.h"
-#include "game/Player.h"
+#include "game/Environment.h"
+#include "game/State.h"
+#include "input/Input.h"
+#include "math/Transform.h"
 #include "serial/StreamBuffer.h"
 
-#include <map>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
 #include <memory>
-#include <set>
+#include <unordered_map>
+#include <vector>
 
+/**
+ * The players of a tick, stored as parallel arrays so simulating,
+ * snapshotting and interpolating them walks contiguous memory rather than
+ * chasing a pointer per player. Players are kept ordered by id, ids are the
+ * stable handle and are mapped to their current index. Adding or removing a
+ * player shifts the ones after it, which only happens on a connect or
+ * disconnect.
+ */
 class Frame {
 
 public:
@@ -16,10 +30,37 @@ public:
 
     Frame();
 
-    void addPlayer(uint32_t, Player::Shared);
-    void removePlayer(uint32_t);
-    Player::Shared player(uint32_t) const;
-    const std::map<uint32_t, Player::Shared>& players() const;
+    // adds an idle player at the origin, or resets an existing one, and
+    // returns its index
+    uint32_t add(uint32_t);
+    uint32_t add(uint32_t, const glm::vec3&, const glm::quat&, const glm::vec3&, State::Shared);
+    void remove(uint32_t);
+    void clear();
+    // index of the player, -1 if it isn't in the frame
+    int32_t find(uint32_t) const;
+    uint32_t size() const;
+
+    const std::vector<uint32_t>& ids() const;
+    const std::vector<glm::vec3>& translations() const;
+    const std::vector<glm::quat>& rotations() const;
+    const std::vector<glm::vec3>& scales() const;
+    const std::vector<State::Shared>& states() const;
+
+    void setTranslation(uint32_t, const glm::vec3&);
+    void setRotation(uint32_t, const glm::quat&);
+    void rotateGlobal(uint32_t, float32_t, const glm::vec3&);
+    // moves the player along the translation, dropping it onto the terrain
+    void moveAlong(uint32_t, const glm::vec3&, const Environment::Shared&);
+    // direction the player faces
+    glm::vec3 forward(uint32_t) const;
+    glm::mat4 matrix(uint32_t) const;
+    // copy of the player's transform
+    Transform::Shared transform(uint32_t) const;
+
+    void handleInput(uint32_t, const Input::Shared&);
+    void update(uint32_t, const Environment::Shared&, std::time_t);
+    // updates every player
+    void update(const Environment::Shared&, std::time_t);
 
     void setTimestamp(std::time_t);
     std::time_t timestamp() const;
@@ -33,7 +74,15 @@ private:
     // prevent assignment
     Frame& operator=(const Frame&);
 
-    std::map<uint32_t, Player::Shared> players_;
+    // point the ids from the index onwards at their current index
+    void reindex(uint32_t);
+
+    std::vector<uint32_t> ids_;
+    std::vector<glm::vec3> translations_;
+    std::vector<glm::quat> rotations_;
+    std::vector<glm::vec3> scales_;
+    std::vector<State::Shared> states_;
+    std::unordered_map<uint32_t, uint32_t> indices_;
     std::time_t timestamp_;
 };
 
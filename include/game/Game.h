@@ -4,19 +4,92 @@
 
 namespace Net {
 enum Types {
-    CLIENT_INFO
+    CLIENT_INFO,
+    TIME_SYNC
 };
 }
 
 namespace Game {
 
-// num server steps per sec
+// num server steps per sec, unless set at runtime
 const uint32_t STEPS_PER_SEC = 10;
 
 // step duration in microseconds
 const std::time_t STEP_DURATION = (1.0 / STEPS_PER_SEC) * 1000000;
 
-// the interpolation delay for a client in microseconds.
-// 3x packet send rate interpolation
-const std::time_t INTERPOLATION_DELAY = STEP_DURATION * 3;
+// snapshots per sec sent to a client that hasn't asked for a rate, at most
+// the step rate
+const uint32_t SEND_RATE = 10;
+
+// the lowest snapshot rate a client that can't keep up is backed off to
+const uint32_t MIN_SEND_RATE = 2;
+
+// a client whose snapshot acks lag further than this behind what it has been
+// sent, beyond the send interval, has its rate halved
+const std::time_t MAX_ACK_LAG = 500000;
+
+// the interpolation delay for a client in server steps, until it has
+// measured its link
+const uint32_t INTERPOLATION_STEPS = 3;
+
+// default bounds of the measured interpolation delay in server steps
+const uint32_t MIN_INTERPOLATION_STEPS = 1;
+const uint32_t MAX_INTERPOLATION_STEPS = 10;
+
+// the number of sent / received snapshots kept for delta compression
+const uint32_t SNAPSHOT_HISTORY = 32;
+
+// players further than this from a client are not sent to it
+const float32_t INTEREST_RADIUS = 64.0f;
+
+// players further than this from a client are sent at a lower rate
+const float32_t INTEREST_NEAR_RADIUS = 16.0f;
+
+// number of snapshots between updates of far away players
+const uint32_t INTEREST_FAR_INTERVAL = 3;
+
+// most bytes of player updates each client is sent per snapshot
+const uint32_t SNAPSHOT_BUDGET = 1200;
+
+// a congested client's budget is halved down to this, enough for its own
+// player and a few others
+const uint32_t MIN_SNAPSHOT_BUDGET = 300;
+
+// bytes a client's budget recovers by each time its link is sampled clear
+const uint32_t SNAPSHOT_BUDGET_STEP = 100;
+
+// a link losing more packets than this, or whose round trip has risen this
+// many milliseconds above the lowest seen, is treated as congested
+const float32_t MAX_PACKET_LOSS = 0.02f;
+const uint32_t MAX_QUEUEING_DELAY = 100;
+
+// distance a player has moved since a client was last sent it that doubles
+// the rate its priority accumulates
+const float32_t PRIORITY_MOVE_DISTANCE = 1.0f;
+
+// most unacknowledged inputs a client sends in one batch, at most 255. Any
+// more wait for the older ones to be acknowledged
+const uint32_t INPUT_REDUNDANCY = 16;
+
+// server steps between resends of unacknowledged inputs when there are no
+// new ones
+const uint32_t INPUT_RESEND_STEPS = 1;
+
+// time between clock synchronization requests in microseconds
+const std::time_t CLOCK_SYNC_INTERVAL = 1000000;
+
+// number of recent clock samples the lowest round trip is picked from
+const uint32_t CLOCK_SYNC_SAMPLES = 8;
+
+// samples needed before the clock is trusted, requested every step until then
+const uint32_t CLOCK_SYNC_MIN_SAMPLES = 4;
+
+// radius of the sphere players are hit tested as
+const float32_t PLAYER_RADIUS = 0.87f;
+
+// how far back the server keeps player transforms to rewind queries to
+const std::time_t LAG_COMPENSATION_HISTORY = 1000000;
+
+// player ids at or above this are server controlled, client ids are below
+const uint32_t NPC_ID_OFFSET = 1 << 24;
 }
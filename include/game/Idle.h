@@ -2,7 +2,6 @@
 
 #include "Common.h"
 #include "game/Environment.h"
-#include "game/Player.h"
 #include "game/State.h"
 #include "input/Input.h"
 #include "serial/StreamBuffer.h"
@@ -16,7 +15,7 @@ public:
     explicit Idle(const Input::Shared& = nullptr);
 
     State::Shared handleInput(const Input::Shared&);
-    State::Shared update(Player::Shared&, Environment::Shared, std::time_t);
+    State::Shared update(Frame&, uint32_t, Environment::Shared, std::time_t);
 
 protected:
     StreamBuffer::Shared& serialize(StreamBuffer::Shared&) const;
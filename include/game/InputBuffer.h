@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Common.h"
+#include "input/Input.h"
+#include "serial/StreamBuffer.h"
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * A client's inputs that the server has not acknowledged yet. Every batch
+ * sent carries the oldest of them, up to the batch size, so a lost batch is
+ * covered by the next one. None are given up on, the server only accepts
+ * them in order.
+ */
+class InputBuffer {
+
+public:
+    typedef std::shared_ptr<InputBuffer> Shared;
+    static Shared alloc(uint32_t);
+
+    explicit InputBuffer(uint32_t);
+
+    // numbers the input and keeps it until acknowledged
+    uint32_t add(const Input::Shared&);
+    // drops every input up to and including the sequence number
+    void ack(uint32_t);
+    bool empty() const;
+    void clear();
+
+    // written along with the server time the client is rendering
+    StreamBuffer::Shared serialize(std::time_t) const;
+
+private:
+    // prevent copy-construction
+    InputBuffer(const InputBuffer&);
+    // prevent assignment
+    InputBuffer& operator=(const InputBuffer&);
+
+    // most inputs written in a batch
+    uint32_t batchSize_;
+    uint32_t sequence_;
+    std::deque<std::pair<uint32_t, Input::Shared> > pending_;
+};
+
+/**
+ * Read a batch of inputs along with their sequence numbers, and the server
+ * time the client was rendering when it sent them.
+ */
+std::vector<std::pair<uint32_t, Input::Shared> > deserializeInputs(StreamBuffer::Shared&, std::time_t&);
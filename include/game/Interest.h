@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Common.h"
+
+/**
+ * Area-of-interest settings used to decide which players are replicated to
+ * a client and how fast their priority for an update accumulates. Players
+ * are sent once their priority reaches 1, highest first, as far as the
+ * snapshot budget allows.
+ */
+struct Interest {
+
+    Interest(float32_t radius, float32_t nearRadius, uint32_t farInterval);
+
+    // players outside of this radius are not replicated
+    float32_t radius;
+    // players inside of this radius gain a full update of priority every
+    // snapshot
+    float32_t nearRadius;
+    // players beyond the near radius gain priority this many times slower,
+    // so are due an update about once every this many snapshots
+    uint32_t farInterval;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Common.h"
+
+#include <ctime>
+#include <memory>
+#include <vector>
+
+/**
+ * Adapts how far behind the server a client renders to how late its
+ * snapshots arrive. Each arrival records how long past the newest frame
+ * already held the server clock had run, which covers the transit time, its
+ * jitter, the tick spacing and any lost snapshots in one measure. The delay
+ * targets a high percentile of it, grows straight away and only shrinks once
+ * the link has stayed better for a while. The delay itself moves towards the
+ * target a little faster or slower than real time so the change isn't seen.
+ * Margins are in fractions of the server's step duration, as that sets how
+ * far apart the frames are.
+ */
+class InterpolationDelay {
+
+public:
+    typedef std::shared_ptr<InterpolationDelay> Shared;
+    // step duration, and bounds of the delay
+    static Shared alloc(std::time_t, std::time_t, std::time_t);
+
+    InterpolationDelay(std::time_t, std::time_t, std::time_t);
+
+    // server timestamp of a frame and the server time it arrived
+    void add(std::time_t, std::time_t);
+    // moves the delay towards the target by the elapsed time
+    void update(std::time_t);
+    void clear();
+
+    std::time_t delay() const;
+    std::time_t target() const;
+
+private:
+    // prevent copy-construction
+    InterpolationDelay(const InterpolationDelay&);
+    // prevent assignment
+    InterpolationDelay& operator=(const InterpolationDelay&);
+
+    std::time_t measure() const;
+
+    std::time_t stepDuration_;
+    std::time_t min_;
+    std::time_t max_;
+    // time from the newest frame held to each arrival, a ring of the most
+    // recent ones
+    std::vector<std::time_t> lateness_;
+    uint32_t next_;
+    uint32_t count_;
+    // reused to find the percentile without allocating
+    mutable std::vector<std::time_t> sorted_;
+    std::time_t newest_;
+    float64_t delay_;
+    std::time_t target_;
+    // how long a lower target has held
+    std::time_t lower_;
+};
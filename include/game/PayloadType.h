@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Common.h"
+
+namespace PayloadType {
+enum Types {
+    INPUT,
+    SNAPSHOT,
+    SNAPSHOT_ACK
+};
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Common.h"
+#include "game/Frame.h"
+#include "geometry/Intersection.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <ctime>
+#include <memory>
+#include <vector>
+
+struct PlayerRecord {
+    uint32_t id;
+    glm::vec3 translation;
+    glm::quat rotation;
+};
+
+/**
+ * The transforms of every player over the last few ticks, so queries can be
+ * run against the world as a client saw it rather than as it is now. All
+ * memory is reserved up front, the capacity in ticks times the most players
+ * recorded per tick, and the oldest tick is overwritten by the newest.
+ * Rewinding interpolates between the two ticks either side of the time.
+ */
+class PlayerHistory {
+
+public:
+    typedef std::shared_ptr<PlayerHistory> Shared;
+    static Shared alloc(uint32_t, uint32_t);
+
+    PlayerHistory(uint32_t, uint32_t);
+
+    // records the players of the frame at its timestamp
+    void record(const Frame::Shared&);
+    void clear();
+
+    std::time_t oldest() const;
+    std::time_t newest() const;
+    // bytes reserved for the history
+    size_t size() const;
+
+    // the players at the time, which is clamped to the history, ordered by id
+    void rewind(std::time_t, std::vector<PlayerRecord>&) const;
+    // nearest player the ray hits at the time, other than the ignored one
+    bool raycast(std::time_t, const glm::vec3&, const glm::vec3&, uint32_t, uint32_t&, Intersection&) const;
+    // players within the radius of the point at the time
+    void overlap(std::time_t, const glm::vec3&, float32_t, std::vector<uint32_t>&) const;
+
+private:
+    // prevent copy-construction
+    PlayerHistory(const PlayerHistory&);
+    // prevent assignment
+    PlayerHistory& operator=(const PlayerHistory&);
+
+    struct Tick {
+        Tick()
+            : timestamp(0)
+            , count(0)
+        {
+        }
+        std::time_t timestamp;
+        uint32_t count;
+    };
+
+    // index of the nth oldest tick
+    uint32_t slot(uint32_t) const;
+    const PlayerRecord* records(uint32_t) const;
+    // the nth oldest tick at or after the time and how far towards it from
+    // the one before the time is
+    uint32_t find(std::time_t, float32_t&) const;
+    void rewind(std::time_t, std::vector<PlayerRecord>&, bool) const;
+
+    uint32_t capacity_;
+    uint32_t maxPlayers_;
+    // ring of ticks, each owning maxPlayers_ records of the pool
+    std::vector<Tick> ticks_;
+    std::vector<PlayerRecord> pool_;
+    uint32_t head_;
+    uint32_t count_;
+    // reused between queries
+    mutable std::vector<PlayerRecord> scratch_;
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Common.h"
+#include "game/Environment.h"
+#include "game/Frame.h"
+#include "input/Input.h"
+#include "math/Transform.h"
+
+#include <glm/glm.hpp>
+
+#include <ctime>
+#include <deque>
+#include <memory>
+
+/**
+ * Predicts the local player by applying its inputs as soon as they are made
+ * rather than waiting for the server. Times are in server time, shifted
+ * forward by the time an input takes to reach the server, so the prediction
+ * runs where the server will be once it has the inputs. When the server's
+ * state arrives the inputs it hadn't applied yet are replayed on top of it,
+ * a step at a time as the server does, and the difference from what was
+ * predicted is smoothed out rather than snapped to.
+ */
+class Prediction {
+
+public:
+    typedef std::shared_ptr<Prediction> Shared;
+    static Shared alloc();
+
+    Prediction();
+
+    // applies an input straight away, with its sequence number and time
+    void add(uint32_t, const Input::Shared&, std::time_t);
+    // advances the prediction to the time
+    void update(const Environment::Shared&, std::time_t);
+    // restarts from the server's state of the player in the frame, with the
+    // newest input it had applied, and replays the rest up to the time
+    void reconcile(const Frame::Shared&, uint32_t, uint32_t, const Environment::Shared&, std::time_t);
+    void clear();
+    // duration of the server's steps, inputs are replayed in steps of it
+    void setStepDuration(std::time_t);
+
+    // the predicted player's transform with the smoothing applied, nullptr
+    // until the server has sent one
+    Transform::Shared player() const;
+    // distance the rendered player is still off the prediction
+    float32_t error() const;
+
+private:
+    // prevent copy-construction
+    Prediction(const Prediction&);
+    // prevent assignment
+    Prediction& operator=(const Prediction&);
+
+    struct Entry {
+        Entry(uint32_t sequence, const Input::Shared& input, std::time_t time)
+            : sequence(sequence)
+            , input(input)
+            , time(time)
+        {
+        }
+        uint32_t sequence;
+        Input::Shared input;
+        std::time_t time;
+    };
+
+    // inputs the server hasn't acknowledged
+    std::deque<Entry> history_;
+    // a frame holding just the predicted player
+    Frame::Shared player_;
+    // time the prediction has been advanced to
+    std::time_t time_;
+    // timestamp of the newest server state reconciled against
+    std::time_t reconciled_;
+    // offset of the rendered player from the prediction
+    glm::vec3 error_;
+    std::time_t stepDuration_;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Common.h"
+#include "game/Frame.h"
+#include "serial/StreamBuffer.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace SnapshotField {
+enum Types {
+    TRANSLATION = 1 << 0,
+    ROTATION = 1 << 1,
+    SCALE = 1 << 2,
+    STATE = 1 << 3,
+    ALL = TRANSLATION | ROTATION | SCALE | STATE
+};
+}
+
+/**
+ * The players sent in a snapshot, laid out like a frame as parallel arrays
+ * ordered by id. The states are serialized once into a single buffer and
+ * each player keeps the offset of its bytes, so building, diffing and
+ * writing a snapshot never allocates per player. Players can only be added
+ * in id order.
+ */
+class Snapshot {
+
+public:
+    typedef std::shared_ptr<Snapshot> Shared;
+    static Shared alloc(uint32_t, std::time_t = 0);
+    static Shared alloc(uint32_t, const Frame::Shared&);
+
+    explicit Snapshot(uint32_t, std::time_t = 0);
+    Snapshot(uint32_t, const Frame::Shared&);
+
+    uint32_t id() const;
+    std::time_t timestamp() const;
+
+    void reserve(uint32_t);
+    // appends a player, its id must be greater than any already added
+    void add(uint32_t, const glm::vec3&, const glm::quat&, const glm::vec3&, const uint8_t*, uint32_t);
+    // appends the player at the index of another snapshot
+    void add(const Snapshot::Shared&, uint32_t);
+    // index of the player, -1 if it isn't in the snapshot
+    int32_t find(uint32_t) const;
+    uint32_t size() const;
+
+    const std::vector<uint32_t>& ids() const;
+    const std::vector<glm::vec3>& translations() const;
+    const std::vector<glm::quat>& rotations() const;
+    const std::vector<glm::vec3>& scales() const;
+    // serialized state of the player at the index
+    const uint8_t* state(uint32_t) const;
+    uint32_t stateSize(uint32_t) const;
+
+    // fields of the player at the index that differ from the player at the
+    // index of the other snapshot
+    uint8_t diff(uint32_t, const Snapshot::Shared&, uint32_t) const;
+    // number of bytes the fields in the mask take in a delta
+    uint32_t cost(uint32_t, uint8_t) const;
+
+    Frame::Shared frame() const;
+
+    friend StreamBuffer::Shared& serializeDelta(StreamBuffer::Shared&, const Snapshot::Shared&, const Snapshot::Shared&);
+    friend Snapshot::Shared deserializeDelta(StreamBuffer::Shared&, const Snapshot::Shared&);
+
+private:
+    // prevent copy-construction
+    Snapshot(const Snapshot&);
+    // prevent assignment
+    Snapshot& operator=(const Snapshot&);
+
+    uint32_t id_;
+    std::time_t timestamp_;
+    std::vector<uint32_t> ids_;
+    std::vector<glm::vec3> translations_;
+    std::vector<glm::quat> rotations_;
+    std::vector<glm::vec3> scales_;
+    // the serialized states back to back, a player's bytes run from its
+    // offset to the next one's
+    StreamBuffer::Shared states_;
+    std::vector<uint32_t> offsets_;
+};
+
+/**
+ * Writes the snapshot as a field-level delta against the baseline. The ids
+ * of any removed players are written first, followed by the changed fields
+ * of changed players only. A null baseline produces a full snapshot.
+ */
+StreamBuffer::Shared& serializeDelta(StreamBuffer::Shared&, const Snapshot::Shared&, const Snapshot::Shared&);
+
+/**
+ * Reconstructs a snapshot from a delta written against the baseline. Returns
+ * null if the delta is malformed.
+ */
+Snapshot::Shared deserializeDelta(StreamBuffer::Shared&, const Snapshot::Shared&);
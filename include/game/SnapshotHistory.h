@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Common.h"
+#include "game/Snapshot.h"
+
+#include <memory>
+#include <vector>
+
+class SnapshotHistory {
+
+public:
+    typedef std::shared_ptr<SnapshotHistory> Shared;
+    static Shared alloc(uint32_t);
+
+    explicit SnapshotHistory(uint32_t);
+
+    void add(Snapshot::Shared);
+    Snapshot::Shared find(uint32_t) const;
+    Snapshot::Shared latest() const;
+    void clear();
+
+private:
+    // prevent copy-construction
+    SnapshotHistory(const SnapshotHistory&);
+    // prevent assignment
+    SnapshotHistory& operator=(const SnapshotHistory&);
+
+    // ring buffer indexed by snapshot id
+    std::vector<Snapshot::Shared> snapshots_;
+    Snapshot::Shared latest_;
+};
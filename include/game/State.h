@@ -7,7 +7,7 @@
 
 #include <memory>
 
-class Player;
+class Frame;
 
 class State {
 
@@ -21,8 +21,10 @@ public:
     uint8_t type() const;
 
     virtual State::Shared handleInput(const Input::Shared&) = 0;
+    // updates the player at the index in the frame
     virtual State::Shared update(
-        std::shared_ptr<Player>&,
+        Frame&,
+        uint32_t,
         Environment::Shared,
         std::time_t)
         = 0;
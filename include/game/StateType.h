@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Common.h"
-#include "game/StateMachine.h"
+#include "game/State.h"
 #include "serial/StreamBuffer.h"
 
 namespace StateType {
@@ -14,5 +14,7 @@ enum Types {
 };
 }
 
-StreamBuffer::Shared& operator<<(StreamBuffer::Shared&, const StateMachine::Shared&);
-StreamBuffer::Shared& operator>>(StreamBuffer::Shared&, StateMachine::Shared&);
+// writes the state prefixed with its type, so it can be read back without
+// knowing it
+StreamBuffer::Shared& serializeState(StreamBuffer::Shared&, const State::Shared&);
+State::Shared deserializeState(StreamBuffer::Shared&);
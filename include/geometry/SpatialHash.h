@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Common.h"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * Uniform grid over the xz-plane for radius queries of points.
+ */
+class SpatialHash {
+
+public:
+    typedef std::shared_ptr<SpatialHash> Shared;
+    static Shared alloc(float32_t);
+
+    explicit SpatialHash(float32_t);
+
+    void insert(uint32_t, const glm::vec3&);
+    void clear();
+
+    void query(const glm::vec3&, float32_t, std::vector<uint32_t>&) const;
+
+private:
+    // prevent copy-construction
+    SpatialHash(const SpatialHash&);
+    // prevent assignment
+    SpatialHash& operator=(const SpatialHash&);
+
+    int32_t cell(float32_t) const;
+    uint64_t key(int32_t, int32_t) const;
+
+    float32_t cellSize_;
+    std::unordered_map<uint64_t, std::vector<std::pair<uint32_t, glm::vec3> > > cells_;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "loopback/LoopbackPacket.h"
+#include "loopback/LoopbackServer.h"
+#include "net/Client.h"
+#include "net/Compression.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * An in-process client of a `LoopbackServer`.
+ */
+class LoopbackClient : public Client {
+
+public:
+    typedef std::shared_ptr<LoopbackClient> Shared;
+    static Shared alloc(LoopbackServer::Shared);
+
+    explicit LoopbackClient(LoopbackServer::Shared);
+    ~LoopbackClient();
+
+    // NOTE: the host is ignored, the port must match the server's
+    bool connect(const std::string&, uint32_t);
+    bool disconnect();
+    bool isConnected() const;
+
+    void send(DeliveryType, StreamBuffer::Shared) const;
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
+    std::vector<Message::Shared> poll();
+
+    void on(uint32_t, RequestHandler);
+
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    PeerStats stats() const;
+
+    // called by the server
+    void deliver(const LoopbackPacket&);
+    void disconnected();
+
+private:
+    void sendMessage(DeliveryType type, Message::Shared msg) const;
+    uint32_t sendRequest(uint32_t requestId, StreamBuffer::Shared stream) const;
+    void sendResponse(uint32_t requestId, StreamBuffer::Shared stream) const;
+    void handleRequest(const Message::Shared&) const;
+    void sampleStats(std::time_t now);
+
+    // prevent copy-construction
+    LoopbackClient(const LoopbackClient&);
+    // prevent assignment
+    LoopbackClient& operator=(const LoopbackClient&);
+
+    LoopbackServer::Shared server_;
+    bool connected_;
+    // id assigned by the server
+    uint32_t id_;
+    // packets waiting for the next flush
+    mutable std::vector<LoopbackPacket> outgoing_;
+    // messages delivered by the server since the last poll
+    std::vector<Message::Shared> received_;
+    std::map<uint32_t, RequestHandler> handlers_;
+    RequestTable::Shared requests_;
+    mutable uint32_t currentMsgId_;
+    mutable uint32_t numQueued_;
+    // id of the newest sequenced message received, if there has been one
+    uint32_t sequence_;
+    bool hasSequence_;
+    Compression compression_;
+    // mutable so that sends can update the statistics
+    mutable PeerStats stats_;
+    // totals at the previous sample
+    PeerStats last_;
+    std::time_t lastSample_;
+};
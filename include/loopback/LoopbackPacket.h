@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Common.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * The serialized bytes of a message in flight between a loopback server and
+ * client. Broadcasts share the same bytes between every recipient.
+ */
+struct LoopbackPacket {
+    LoopbackPacket()
+        : type(DeliveryType::RELIABLE)
+    {
+    }
+    LoopbackPacket(DeliveryType type, std::shared_ptr<const std::vector<uint8_t>> data)
+        : type(type)
+        , data(data)
+    {
+    }
+    DeliveryType type;
+    std::shared_ptr<const std::vector<uint8_t>> data;
+};
+
+/**
+ * Copy the serialized bytes of a message into a packet.
+ */
+LoopbackPacket writePacket(DeliveryType, const Message::Shared&);
+
+/**
+ * Deserialize a packet received from a peer. The message views the packet
+ * bytes rather than copying them.
+ */
+Message::Shared readPacket(uint32_t, const LoopbackPacket&);
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "loopback/LoopbackPacket.h"
+#include "net/Compression.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
+#include "net/Server.h"
+
+#include <map>
+#include <memory>
+#include <vector>
+
+class LoopbackClient;
+
+/**
+ * An in-process server that exchanges messages with `LoopbackClient`s
+ * through memory rather than sockets. Nothing is lost, so unreliable
+ * messages behave like reliable ones, but stale sequenced messages are still
+ * dropped.
+ */
+class LoopbackServer : public Server {
+
+public:
+    typedef std::shared_ptr<LoopbackServer> Shared;
+    // NOTE: messages are handed over on `flush`, all methods of the server
+    // and its clients must be called from a single thread
+    static Shared alloc();
+
+    LoopbackServer();
+    ~LoopbackServer();
+
+    bool start(uint32_t, uint32_t = DEFAULT_MAX_CONNECTIONS);
+    bool stop();
+    bool isRunning() const;
+
+    uint32_t numClients() const;
+
+    void send(uint32_t, DeliveryType, StreamBuffer::Shared) const;
+    void broadcast(DeliveryType, StreamBuffer::Shared) const;
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
+    std::vector<Message::Shared> poll();
+
+    void on(uint32_t, RequestHandler);
+
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    std::vector<PeerStats> stats() const;
+
+    uint32_t port() const;
+
+    // called by the clients
+    bool connect(LoopbackClient*, uint32_t&);
+    void disconnect(uint32_t);
+    void deliver(uint32_t, const LoopbackPacket&);
+
+private:
+    // state for a single connection
+    struct PeerEntry {
+        PeerEntry()
+            : client(nullptr)
+            , sequence(0)
+            , hasSequence(false)
+        {
+        }
+        // nullptr if the slot is free
+        LoopbackClient* client;
+        // id of the newest sequenced message received
+        uint32_t sequence;
+        bool hasSequence;
+        // packets waiting for the next flush
+        std::vector<LoopbackPacket> outgoing;
+        PeerStats stats;
+        // totals at the previous sample
+        PeerStats last;
+    };
+
+    PeerEntry* getClient(uint32_t) const;
+    void sendMessage(uint32_t id, DeliveryType type, Message::Shared msg) const;
+    uint32_t sendRequest(uint32_t, uint32_t requestId, StreamBuffer::Shared stream) const;
+    void sendResponse(uint32_t, uint32_t requestId, StreamBuffer::Shared stream) const;
+    void handleRequest(const Message::Shared&) const;
+    void sampleStats(std::time_t now);
+
+    // prevent copy-construction
+    LoopbackServer(const LoopbackServer&);
+    // prevent assignment
+    LoopbackServer& operator=(const LoopbackServer&);
+
+    bool running_;
+    uint32_t port_;
+    // indexed by client id, mutable so that sends can queue packets
+    mutable std::vector<PeerEntry> peers_;
+    uint32_t numClients_;
+    // messages delivered by the clients since the last poll
+    std::vector<Message::Shared> received_;
+    std::map<uint32_t, RequestHandler> handlers_;
+    RequestTable::Shared requests_;
+    mutable uint32_t currentMsgId_;
+    mutable uint32_t numQueued_;
+    Compression compression_;
+    std::time_t lastSample_;
+};
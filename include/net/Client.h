@@ -1,8 +1,11 @@
 #pragma once
 
 #include "Common.h"
+#include "net/Compression.h"
 #include "net/DeliveryType.h"
 #include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
 #include "serial/StreamBuffer.h"
 
 #include <memory>
@@ -21,11 +24,24 @@ public:
     virtual bool isConnected() const = 0;
 
     virtual void send(DeliveryType, StreamBuffer::Shared) const = 0;
-    virtual Message::Shared request(uint32_t, StreamBuffer::Shared) = 0;
+    // sends everything queued since the last flush, returns the number of
+    // datagrams sent
+    virtual uint32_t flush() = 0;
+    virtual uint32_t numQueued() const = 0;
+    // sends a request without blocking, the handler is called from `poll`
+    // once the response arrives or the request fails
+    virtual void request(uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT) = 0;
     virtual std::vector<Message::Shared> poll() = 0;
 
     virtual void on(uint32_t, RequestHandler) = 0;
 
+    // selects the codec for outgoing datagrams, must be set before connecting
+    virtual void setCompression(Compression) = 0;
+    virtual CompressionStats compressionStats() const = 0;
+
+    // connection statistics, sampled every STATS_INTERVAL
+    virtual PeerStats stats() const = 0;
+
 private:
     // prevent copy-construction
     Client(const Client&);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Common.h"
+
+#include <ctime>
+#include <string>
+
+enum class Compression {
+    NONE,
+    // ENet's built-in range coder
+    RANGE_CODER,
+    // adaptive range coder with a model trained on snapshots
+    ADAPTIVE
+};
+
+/**
+ * Datagram compression totals since the host was started.
+ */
+struct CompressionStats {
+    CompressionStats()
+        : datagrams(0)
+        , bytesIn(0)
+        , bytesOut(0)
+        , compressTime(0)
+        , decompressTime(0)
+    {
+    }
+    uint64_t datagrams;
+    // bytes offered for compression, and bytes actually put on the wire
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+    // microseconds spent in the codec
+    std::time_t compressTime;
+    std::time_t decompressTime;
+};
+
+/**
+ * Parses a codec name: none, range or adaptive. Returns 0 on success.
+ */
+bool parseCompression(const std::string&, Compression&);
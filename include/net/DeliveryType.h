@@ -2,5 +2,7 @@
 
 enum class DeliveryType {
     RELIABLE,
-    UNRELIABLE
+    UNRELIABLE,
+    // unreliable, but stale or out-of-order messages are dropped on receipt
+    SEQUENCED
 };
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Common.h"
+#include "net/DeliveryType.h"
+#include "net/NetworkConditions.h"
+
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+/**
+ * Delays, drops, duplicates and reorders sends according to a set of network
+ * conditions. Reliable sends are never dropped, a lost one arrives a round
+ * trip late instead, and they stay in order. Stale sequenced sends are
+ * dropped as the receiver would. Each peer has a link of its own, so a
+ * bandwidth limit applies to every client separately.
+ */
+class LinkSimulator {
+
+public:
+    typedef std::shared_ptr<LinkSimulator> Shared;
+    typedef std::function<void()> Send;
+    static Shared alloc(const NetworkConditions&);
+
+    explicit LinkSimulator(const NetworkConditions&);
+
+    // schedules a send of the given size to a peer
+    void schedule(uint32_t peer, DeliveryType, size_t bytes, Send);
+    // performs the sends that are due, returns the number performed
+    uint32_t release(std::time_t now);
+    size_t size() const;
+    void clear();
+
+private:
+    struct Pending {
+        std::time_t release;
+        // order of scheduling, breaks ties
+        uint64_t order;
+        Send send;
+    };
+    struct Later {
+        bool operator()(const Pending& a, const Pending& b) const
+        {
+            return a.release > b.release || (a.release == b.release && a.order > b.order);
+        }
+    };
+
+    bool chance(float32_t);
+    std::time_t delay();
+    void push(std::time_t release, Send);
+
+    // prevent copy-construction
+    LinkSimulator(const LinkSimulator&);
+    // prevent assignment
+    LinkSimulator& operator=(const LinkSimulator&);
+
+    NetworkConditions conditions_;
+    std::mt19937 rng_;
+    std::priority_queue<Pending, std::vector<Pending>, Later> pending_;
+    uint64_t order_;
+    // per peer time the link finishes transmitting what has been scheduled
+    // so far
+    std::map<uint32_t, std::time_t> linkFree_;
+    // per peer release time of the latest reliable send
+    std::map<uint32_t, std::time_t> reliable_;
+    // per peer order of the latest sequenced send scheduled and released
+    std::map<uint32_t, uint64_t> scheduled_;
+    std::map<uint32_t, uint64_t> released_;
+};
@@ -2,6 +2,7 @@
 
 #include "serial/StreamBuffer.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -18,6 +19,11 @@ enum Types {
 };
 }
 
+/**
+ * Size of the serialized message header: id, request id and type.
+ */
+const size_t MESSAGE_HEADER_SIZE = 9;
+
 class Message {
 
 public:
@@ -38,7 +44,10 @@ public:
     uint8_t type() const;
     StreamBuffer::Shared stream() const;
 
-    std::vector<uint8_t> serialize() const;
+    // NOTE: the header is written into the headroom of the stream when
+    // available so the payload is not copied. The returned bytes are owned by
+    // the message and the stream must not be written to after serializing.
+    const uint8_t* serialize(size_t&) const;
     void deserialize(StreamBuffer::Shared);
 
 private:
@@ -52,4 +61,13 @@ private:
     uint32_t requestId_;
     uint8_t type_;
     StreamBuffer::Shared stream_;
+    // serialized copy, only used when the stream has no headroom
+    mutable StreamBuffer::Shared framed_;
+    mutable bool prepended_;
 };
+
+/**
+ * Called with the response to a request, or with nullptr if the request timed
+ * out or the peer disconnected before responding.
+ */
+typedef std::function<void(Message::Shared)> ResponseHandler;
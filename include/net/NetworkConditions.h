@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Common.h"
+
+#include <ctime>
+#include <string>
+
+/**
+ * Impairments applied to the messages sent over a simulated link.
+ */
+struct NetworkConditions {
+    NetworkConditions()
+        : latency(0)
+        , jitter(0)
+        , loss(0)
+        , duplicate(0)
+        , reorder(0)
+        , bandwidth(0)
+        , seed(0)
+    {
+    }
+    // one way delay and its random variation, in microseconds
+    std::time_t latency;
+    std::time_t jitter;
+    // probabilities in [0, 1]
+    float32_t loss;
+    float32_t duplicate;
+    float32_t reorder;
+    // bytes per second, 0 is unlimited
+    uint32_t bandwidth;
+    uint32_t seed;
+};
+
+/**
+ * Parses a comma separated list of conditions such as
+ * `latency=100,jitter=20,loss=2,duplicate=1,reorder=1,bandwidth=512,seed=7`.
+ * Times are in milliseconds, probabilities in percent and bandwidth in
+ * kilobits per second. Returns 0 on success.
+ */
+bool parseConditions(const std::string&, NetworkConditions&);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Common.h"
+
+#include <ctime>
+
+/**
+ * Time in microseconds between samples of the connection statistics.
+ */
+const std::time_t STATS_INTERVAL = 1000000;
+
+/**
+ * Connection statistics for a single peer, as of the last sample.
+ */
+struct PeerStats {
+    PeerStats()
+        : id(0)
+        , roundTripTime(0)
+        , roundTripTimeVariance(0)
+        , packetLoss(0)
+        , reliableInTransit(0)
+        , retransmits(0)
+        , messagesSent(0)
+        , messagesReceived(0)
+        , bytesSent(0)
+        , bytesReceived(0)
+        , messagesSentPerSec(0)
+        , messagesReceivedPerSec(0)
+        , bytesSentPerSec(0)
+        , bytesReceivedPerSec(0)
+    {
+    }
+    uint32_t id;
+    // smoothed round trip time and its variance in milliseconds
+    uint32_t roundTripTime;
+    uint32_t roundTripTimeVariance;
+    // fraction of reliable packets lost, in [0, 1]
+    float32_t packetLoss;
+    // reliable bytes sent but not yet acknowledged
+    uint32_t reliableInTransit;
+    // reliable packets resent because they weren't acknowledged in time
+    uint64_t retransmits;
+    // totals since connecting
+    uint64_t messagesSent;
+    uint64_t messagesReceived;
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    // rates over the last sample interval
+    float32_t messagesSentPerSec;
+    float32_t messagesReceivedPerSec;
+    float32_t bytesSentPerSec;
+    float32_t bytesReceivedPerSec;
+};
+
+/**
+ * Set the per second rates from the totals of the previous sample.
+ */
+void updateRates(PeerStats&, const PeerStats& last, std::time_t elapsed);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Common.h"
+#include "net/Message.h"
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <vector>
+
+/**
+ * Default time in microseconds to wait for a response before a request
+ * fails.
+ */
+const std::time_t REQUEST_TIMEOUT = 5000000;
+
+class RequestTable {
+
+public:
+    typedef std::shared_ptr<RequestTable> Shared;
+    static Shared alloc();
+
+    RequestTable();
+
+    void add(uint32_t id, uint32_t peerId, ResponseHandler, std::time_t timeout);
+    bool resolve(const Message::Shared&);
+    void expire(std::time_t now);
+    void cancel(uint32_t peerId);
+    void clear();
+    size_t size() const;
+
+private:
+    // prevent copy-construction
+    RequestTable(const RequestTable&);
+    // prevent assignment
+    RequestTable& operator=(const RequestTable&);
+
+    struct Pending {
+        uint32_t peerId;
+        ResponseHandler handler;
+        std::time_t deadline;
+    };
+
+    // outstanding requests indexed by request message id
+    std::map<uint32_t, Pending> pending_;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Common.h"
+
+#include <atomic>
+#include <vector>
+
+/**
+ * Bounded lock-free queue for exactly one producer thread and one consumer
+ * thread. `push` fails rather than blocking when the queue is full.
+ */
+template <typename T>
+class SPSCQueue {
+
+public:
+    explicit SPSCQueue(size_t);
+
+    bool push(const T&);
+    bool pop(T&);
+    bool empty() const;
+
+private:
+    // prevent copy-construction
+    SPSCQueue(const SPSCQueue&);
+    // prevent assignment
+    SPSCQueue& operator=(const SPSCQueue&);
+
+    // one slot is always left empty to tell a full queue from an empty one
+    std::vector<T> buffer_;
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+};
+
+template <typename T>
+SPSCQueue<T>::SPSCQueue(size_t capacity)
+    : buffer_(capacity + 1)
+    , head_(0)
+    , tail_(0)
+{
+}
+
+template <typename T>
+bool SPSCQueue<T>::push(const T& item)
+{
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % buffer_.size();
+    if (next == head_.load(std::memory_order_acquire)) {
+        // full
+        return false;
+    }
+    buffer_[tail] = item;
+    tail_.store(next, std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool SPSCQueue<T>::pop(T& item)
+{
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        // empty
+        return false;
+    }
+    item = buffer_[head];
+    // reset the slot so it doesn't keep anything alive
+    buffer_[head] = T();
+    head_.store((head + 1) % buffer_.size(), std::memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool SPSCQueue<T>::empty() const
+{
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+}
@@ -1,13 +1,26 @@
 #pragma once
 
 #include "Common.h"
+#include "net/Compression.h"
 #include "net/DeliveryType.h"
 #include "net/Message.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
 #include "serial/StreamBuffer.h"
 
 #include <memory>
 #include <vector>
 
+/**
+ * Default number of clients a server accepts.
+ */
+const uint32_t DEFAULT_MAX_CONNECTIONS = 64;
+
+/**
+ * Largest peer id a server can assign, ids are in [0, MAX_PEER_ID].
+ */
+const uint32_t MAX_PEER_ID = 4095;
+
 class Server {
 
 public:
@@ -16,7 +29,7 @@ public:
     Server();
     virtual ~Server();
 
-    virtual bool start(uint32_t) = 0;
+    virtual bool start(uint32_t, uint32_t = DEFAULT_MAX_CONNECTIONS) = 0;
     virtual bool stop() = 0;
     virtual bool isRunning() const = 0;
 
@@ -24,10 +37,24 @@ public:
 
     virtual void send(uint32_t, DeliveryType, StreamBuffer::Shared) const = 0;
     virtual void broadcast(DeliveryType, StreamBuffer::Shared) const = 0;
+    // sends everything queued since the last flush, returns the number of
+    // datagrams sent
+    virtual uint32_t flush() = 0;
+    virtual uint32_t numQueued() const = 0;
+    // sends a request to a client without blocking, the handler is called
+    // from `poll` once the response arrives or the request fails
+    virtual void request(uint32_t, uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT) = 0;
     virtual std::vector<Message::Shared> poll() = 0;
 
     virtual void on(uint32_t, RequestHandler) = 0;
 
+    // selects the codec for outgoing datagrams, must be set before starting
+    virtual void setCompression(Compression) = 0;
+    virtual CompressionStats compressionStats() const = 0;
+
+    // connection statistics, sampled every STATS_INTERVAL
+    virtual std::vector<PeerStats> stats() const = 0;
+
 private:
     // prevent copy-construction
     Server(const Server&);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "net/Client.h"
+#include "net/Compression.h"
+#include "net/DeliveryType.h"
+#include "net/LinkSimulator.h"
+#include "net/Message.h"
+#include "net/NetworkConditions.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * Wraps a client and applies network conditions to everything it sends.
+ * Decorate the server as well to impair both directions.
+ */
+class SimulatedClient : public Client {
+
+public:
+    typedef std::shared_ptr<SimulatedClient> Shared;
+    // NOTE: delayed sends are passed on when polling or flushing, so the
+    // delays are only as precise as the frame rate
+    static Shared alloc(Client::Shared, const NetworkConditions&);
+
+    SimulatedClient(Client::Shared, const NetworkConditions&);
+
+    bool connect(const std::string&, uint32_t);
+    bool disconnect();
+    bool isConnected() const;
+
+    void send(DeliveryType, StreamBuffer::Shared) const;
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
+    std::vector<Message::Shared> poll();
+
+    void on(uint32_t, RequestHandler);
+
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    PeerStats stats() const;
+
+private:
+    // prevent copy-construction
+    SimulatedClient(const SimulatedClient&);
+    // prevent assignment
+    SimulatedClient& operator=(const SimulatedClient&);
+
+    Client::Shared client_;
+    LinkSimulator::Shared link_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "net/Compression.h"
+#include "net/DeliveryType.h"
+#include "net/LinkSimulator.h"
+#include "net/Message.h"
+#include "net/NetworkConditions.h"
+#include "net/PeerStats.h"
+#include "net/RequestTable.h"
+#include "net/Server.h"
+
+#include <memory>
+#include <vector>
+
+/**
+ * Wraps a server and applies network conditions to everything it sends.
+ * Decorate the client as well to impair both directions.
+ */
+class SimulatedServer : public Server {
+
+public:
+    typedef std::shared_ptr<SimulatedServer> Shared;
+    // NOTE: delayed sends are passed on when polling or flushing, so the
+    // delays are only as precise as the tick rate
+    static Shared alloc(Server::Shared, const NetworkConditions&);
+
+    SimulatedServer(Server::Shared, const NetworkConditions&);
+
+    bool start(uint32_t, uint32_t = DEFAULT_MAX_CONNECTIONS);
+    bool stop();
+    bool isRunning() const;
+
+    uint32_t numClients() const;
+
+    void send(uint32_t, DeliveryType, StreamBuffer::Shared) const;
+    void broadcast(DeliveryType, StreamBuffer::Shared) const;
+    uint32_t flush();
+    uint32_t numQueued() const;
+    void request(uint32_t, uint32_t, StreamBuffer::Shared, ResponseHandler, std::time_t = REQUEST_TIMEOUT);
+    std::vector<Message::Shared> poll();
+
+    void on(uint32_t, RequestHandler);
+
+    void setCompression(Compression);
+    CompressionStats compressionStats() const;
+
+    std::vector<PeerStats> stats() const;
+
+private:
+    // prevent copy-construction
+    SimulatedServer(const SimulatedServer&);
+    // prevent assignment
+    SimulatedServer& operator=(const SimulatedServer&);
+
+    Server::Shared server_;
+    LinkSimulator::Shared link_;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Common.h"
+
+#include <vector>
+
+/**
+ * Counts of values in log-linear buckets, HDR histogram style. Each power of
+ * two is split into 32 linear buckets, so any percentile is within ~3% of
+ * the true value whatever its magnitude, in a fixed 15KB and with constant
+ * time recording.
+ */
+class Histogram {
+
+public:
+    Histogram();
+
+    void record(uint64_t);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t max() const;
+    float64_t mean() const;
+    // the value the fraction of recorded values are at or below
+    uint64_t percentile(float64_t) const;
+
+private:
+    static uint32_t index(uint64_t);
+    // highest value that falls in the bucket
+    static uint64_t value(uint32_t);
+
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t max_;
+    float64_t total_;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Common.h"
+#include "profile/Histogram.h"
+
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Phase {
+enum Types {
+    POLL,
+    DECODE,
+    INPUT,
+    FRAME,
+    SERIALIZE,
+    BROADCAST,
+    NUM_PHASES
+};
+}
+
+/**
+ * Time spent in each phase of the server tick. Phases may be entered any
+ * number of times a tick, the time is summed and recorded once the tick ends
+ * so each histogram is of the phase's share of a tick. A tick that runs over
+ * its budget can be broken down by phase before the next one starts.
+ */
+class Profiler {
+
+public:
+    typedef std::shared_ptr<Profiler> Shared;
+    static Shared alloc();
+
+    Profiler();
+
+    void beginTick();
+    // nanoseconds spent in a phase
+    void add(uint8_t, uint64_t);
+    // records the tick and returns its duration in nanoseconds
+    uint64_t endTick();
+
+    // this tick's phases, for when it runs over
+    std::string breakdown() const;
+    // logs the percentiles of every phase since the last dump
+    void dump();
+
+private:
+    // prevent copy-construction
+    Profiler(const Profiler&);
+    // prevent assignment
+    Profiler& operator=(const Profiler&);
+
+    std::chrono::steady_clock::time_point started_;
+    std::vector<uint64_t> current_;
+    // the phases of the last tick, kept for the breakdown
+    std::vector<uint64_t> last_;
+    std::vector<Histogram> phases_;
+    Histogram ticks_;
+};
+
+/**
+ * Adds the time until it goes out of scope to a phase, does nothing without
+ * a profiler.
+ */
+class ProfileScope {
+
+public:
+    ProfileScope(const Profiler::Shared&, uint8_t);
+    ~ProfileScope();
+
+private:
+    // prevent copy-construction
+    ProfileScope(const ProfileScope&);
+    // prevent assignment
+    ProfileScope& operator=(const ProfileScope&);
+
+    Profiler* profiler_;
+    uint8_t phase_;
+    std::chrono::steady_clock::time_point start_;
+};
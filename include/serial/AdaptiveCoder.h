@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Common.h"
+
+#include <cstddef>
+
+/**
+ * Order-0 adaptive range coder. The byte model starts from a prior trained on
+ * serialized snapshot messages and adapts to each buffer as it is coded, so
+ * every buffer can be decoded on its own.
+ *
+ * Both functions return the number of bytes written, or 0 if the output
+ * doesn't fit in the given limit.
+ */
+size_t adaptiveCompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outLimit);
+size_t adaptiveDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outLimit);
@@ -11,23 +11,40 @@
 #include <memory>
 #include <vector>
 
+/**
+ * Number of bytes reserved in front of the data by default, this allows a
+ * message header to be prepended without copying the stream.
+ */
+const size_t STREAM_HEADROOM = 16;
+
 class StreamBuffer {
 
 public:
     typedef std::shared_ptr<StreamBuffer> Shared;
-    static Shared alloc(size_t = 1024);
-    static Shared alloc(const uint8_t*, size_t);
+    static Shared alloc(size_t = 1024, size_t = STREAM_HEADROOM);
+    static Shared alloc(const uint8_t*, size_t); // copy
+    static Shared alloc(const uint8_t*, size_t, std::shared_ptr<const void>); // view
 
-    explicit StreamBuffer(size_t = 1024);
+    explicit StreamBuffer(size_t = 1024, size_t = STREAM_HEADROOM);
     StreamBuffer(const uint8_t*, size_t);
+    // NOTE: a view borrows the bytes rather than copying them, the owner is
+    // held until the stream is destroyed. Writing to a view copies the bytes
+    // first.
+    StreamBuffer(const uint8_t*, size_t, std::shared_ptr<const void>);
+
+    const uint8_t* data() const;
+    size_t size() const;
+    size_t headroom() const;
+    uint8_t* prepend(size_t);
+    bool isView() const;
 
-    const std::vector<uint8_t>& buffer() const;
     void seekg(size_t);
     void seekp(size_t);
     size_t tellg() const;
     size_t tellp() const;
-    size_t size() const;
     bool eof() const;
+    // number of bytes left to read
+    size_t remaining() const;
 
     void write(bool);
     void write(uint8_t);
@@ -42,6 +59,7 @@ public:
     void write(const glm::vec3&);
     void write(const glm::vec4&);
     void write(const glm::quat&);
+    void write(const uint8_t*, size_t);
 
     void read(bool&);
     void read(uint8_t&);
@@ -71,9 +89,22 @@ private:
     // prevent assignment
     StreamBuffer& operator=(const StreamBuffer&);
 
+    void put(uint8_t);
+    // claims the next bytes to read, nullptr and eof if there aren't enough
+    const uint8_t* get(size_t);
+    void detach();
+
     size_t gpos_;
     size_t ppos_;
+    // offset of the data, any bytes before it are headroom
+    size_t begin_;
+    // number of headroom bytes that have not been claimed by `prepend`
+    size_t headroom_;
     std::vector<uint8_t> buffer_;
+    // borrowed bytes, only set for views
+    const uint8_t* view_;
+    size_t viewSize_;
+    std::shared_ptr<const void> owner_;
 };
 
 StreamBuffer::Shared merge(const StreamBuffer::Shared&, const StreamBuffer::Shared&);
@@ -93,6 +124,15 @@ StreamBuffer::Shared& operator>>(StreamBuffer::Shared& stream, std::vector<T>& d
 {
     uint32_t size = 0;
     stream->read(size);
+    // every element takes at least a byte, a larger count is a malformed
+    // stream and must not size the allocation
+    if (size > stream->remaining()) {
+        LOG_ERROR("Vector of " << size << " elements exceeds the "
+                               << stream->remaining() << " bytes remaining");
+        data.clear();
+        stream->seekg(stream->size());
+        return stream;
+    }
     data.resize(size);
     for (auto i = uint32_t(0); i < size; i++) {
         stream->read(data[i]);
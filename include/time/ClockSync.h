@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Common.h"
+
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <utility>
+
+/**
+ * Estimates the offset of the server's clock from ours NTP style, from the
+ * local send and receive times of a request and the server's time when it
+ * handled it. Only the lowest round trip of the recent samples is trusted,
+ * as it has the least queuing to skew the result, and the offset is slewed
+ * towards it. The drift between the two clocks is the slope of those
+ * trusted offsets over a longer history.
+ */
+class ClockSync {
+
+public:
+    typedef std::shared_ptr<ClockSync> Shared;
+    static Shared alloc();
+
+    ClockSync();
+
+    // local send time, server time and local receive time of a request
+    void add(std::time_t, std::time_t, std::time_t);
+    // whether there are enough samples to trust the estimate
+    bool synced() const;
+    // number of samples currently kept
+    uint32_t numSamples() const;
+    void clear();
+
+    // the offset to add to a local time to get the server time
+    std::time_t offset(std::time_t) const;
+    std::time_t serverTime(std::time_t) const;
+    // round trip of the sample the estimate is based on
+    std::time_t roundTripTime() const;
+    // microseconds the server clock gains per microsecond
+    float64_t drift() const;
+
+private:
+    // prevent copy-construction
+    ClockSync(const ClockSync&);
+    // prevent assignment
+    ClockSync& operator=(const ClockSync&);
+
+    void updateDrift();
+
+    struct Sample {
+        Sample(std::time_t roundTripTime, std::time_t offset, std::time_t received)
+            : roundTripTime(roundTripTime)
+            , offset(offset)
+            , received(received)
+        {
+        }
+        std::time_t roundTripTime;
+        std::time_t offset;
+        std::time_t received;
+    };
+
+    std::deque<Sample> samples_;
+    // trusted offset at each update, for the drift
+    std::deque<std::pair<std::time_t, float64_t> > history_;
+    // smoothed offset as of the local time of the last update
+    float64_t offset_;
+    float64_t drift_;
+    std::time_t updated_;
+    std::time_t roundTripTime_;
+    bool hasOffset_;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Common.h"
+
+#include <ctime>
+#include <memory>
+
+/**
+ * Paces a loop to fixed steps on the steady clock. Waiting sleeps until
+ * shortly before the step is due and spins the rest of the way, as sleeps
+ * overshoot by the OS timer granularity. A loop that falls behind is told how
+ * many steps it owes, up to a limit past which the steps are dropped. Times
+ * are reported against the system clock as of the start, so they are
+ * comparable with other machines without ever jumping.
+ */
+class TickScheduler {
+
+public:
+    typedef std::shared_ptr<TickScheduler> Shared;
+    static Shared alloc(std::time_t);
+
+    explicit TickScheduler(std::time_t);
+
+    // waits for the next step and returns the number of steps due, more
+    // than one if the last step overran
+    uint32_t wait();
+
+    std::time_t stepDuration() const;
+    // number of steps run
+    uint64_t tick() const;
+    // scheduled time of the latest step
+    std::time_t time() const;
+    // the current time on the same clock
+    std::time_t now() const;
+
+    // how late the latest wait returned
+    std::time_t lateness() const;
+    // waits that returned more than one step, and steps dropped altogether
+    uint64_t overruns() const;
+    uint64_t dropped() const;
+
+private:
+    // prevent copy-construction
+    TickScheduler(const TickScheduler&);
+    // prevent assignment
+    TickScheduler& operator=(const TickScheduler&);
+
+    std::time_t stepDuration_;
+    // system and steady time of the start
+    std::time_t start_;
+    std::time_t monotonicStart_;
+    // steady time the next step is due, relative to the start
+    std::time_t next_;
+    uint64_t tick_;
+    std::time_t lateness_;
+    uint64_t overruns_;
+    uint64_t dropped_;
+};
@@ -14,6 +14,12 @@ namespace Time {
  */
 std::time_t timestamp();
 
+/**
+ * Get microseconds from a steady clock, which never jumps but only means
+ * anything relative to another reading.
+ */
+std::time_t monotonic();
+
 /**
  * Sleep thread for N microseconds.
  */
@@ -26,6 +32,11 @@ std::time_t fromMinutes(float64_t);
 std::time_t fromSeconds(float64_t);
 std::time_t fromMilliseconds(float64_t);
 
+/**
+ * Converts a rate in hertz to the microseconds between events.
+ */
+std::time_t fromRate(float64_t);
+
 /**
  * Converts the arguments from microseconds to the specified type.
  */
@@ -0,0 +1,297 @@
+#include "Common.h"
+#include "game/ClientView.h"
+#include "game/Frame.h"
+#include "game/Game.h"
+#include "game/Interest.h"
+#include "game/PayloadType.h"
+#include "game/PlayerHistory.h"
+#include "game/Snapshot.h"
+#include "game/SnapshotHistory.h"
+#include "geometry/SpatialHash.h"
+#include "log/Log.h"
+#include "loopback/LoopbackClient.h"
+#include "loopback/LoopbackServer.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+#include "serial/StreamBuffer.h"
+#include "time/Time.h"
+
+#include "glm/glm.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+// Runs the server tick against in-process clients, so that the cost of a tick
+// can be measured without any kernel networking in the way.
+
+const uint32_t PORT = 7000;
+const uint32_t SEED = 1;
+
+// command line options
+uint32_t numClients = 64;
+uint32_t numTicks = 1000;
+
+// simulated client state
+struct Bot {
+    LoopbackClient::Shared client;
+    SnapshotHistory::Shared snapshots;
+    uint32_t id;
+};
+
+LoopbackServer::Shared server;
+Frame::Shared frame;
+std::map<uint32_t, ClientView::Shared> views;
+SpatialHash::Shared spatialIndex;
+PlayerHistory::Shared history;
+uint64_t bytesSent = 0;
+// time spent rewinding a query per client per tick
+std::time_t rewindTime = 0;
+uint64_t numRewinds = 0;
+
+const Interest INTEREST(
+    Game::INTEREST_RADIUS,
+    Game::INTEREST_NEAR_RADIUS,
+    Game::INTEREST_FAR_INTERVAL);
+
+bool parse_args(int32_t argc, char** argv)
+{
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value for argument `" << arg << "`");
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--clients") {
+            numClients = std::stoul(value);
+        } else if (arg == "--ticks") {
+            numTicks = std::max(1ul, std::stoul(value));
+        } else {
+            LOG_ERROR("Unknown argument `" << arg << "`");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t deserialize_ack(StreamBuffer::Shared stream)
+{
+    uint32_t id = 0;
+    stream >> id;
+    return id;
+}
+
+StreamBuffer::Shared serialize_ack(uint32_t id)
+{
+    auto stream = StreamBuffer::alloc();
+    stream << uint8_t(PayloadType::SNAPSHOT_ACK);
+    stream << id;
+    return stream;
+}
+
+void move_players()
+{
+    // deterministic random walk
+    const auto& translations = frame->translations();
+    for (uint32_t i = 0; i < frame->size(); i++) {
+        auto step = glm::vec3(
+            (std::rand() % 21 - 10) * 0.01f,
+            0,
+            (std::rand() % 21 - 10) * 0.01f);
+        frame->setTranslation(i, translations[i] + step);
+    }
+}
+
+void rewind_queries(std::time_t now)
+{
+    // a ray from each client's player as its input would cast, against the
+    // world as the client saw it
+    auto timestamp = Time::timestamp();
+    uint32_t hit = 0;
+    Intersection intersection;
+    for (auto iter : views) {
+        int32_t index = frame->find(iter.first);
+        if (index < 0) {
+            continue;
+        }
+        auto direction = glm::vec3(std::rand() % 21 - 10, 0, std::rand() % 21 - 10);
+        if (glm::dot(direction, direction) < M_EPSILON) {
+            continue;
+        }
+        history->raycast(
+            now - Game::INTERPOLATION_STEPS * Game::STEP_DURATION,
+            frame->translations()[index],
+            direction,
+            iter.first,
+            hit,
+            intersection);
+        numRewinds++;
+    }
+    rewindTime += Time::timestamp() - timestamp;
+}
+
+void server_tick(std::time_t now)
+{
+    for (auto msg : server->poll()) {
+        uint32_t id = msg->peerId();
+        switch (msg->type()) {
+        case MessageType::CONNECT: {
+            auto index = frame->add(id);
+            frame->setTranslation(index, glm::vec3(
+                std::rand() % 200 - 100,
+                0,
+                std::rand() % 200 - 100));
+            views[id] = ClientView::alloc(id, INTEREST);
+            break;
+        }
+        case MessageType::DISCONNECT:
+            frame->remove(id);
+            views.erase(id);
+            break;
+        case MessageType::DATA: {
+            auto stream = msg->stream();
+            uint8_t type = 0;
+            stream >> type;
+            if (type == PayloadType::SNAPSHOT_ACK) {
+                auto view = get(views, id);
+                if (view) {
+                    view->ack(deserialize_ack(stream));
+                }
+            }
+            break;
+        }
+        }
+    }
+    move_players();
+    frame->setTimestamp(now);
+    history->record(frame);
+    rewind_queries(now);
+    // each view numbers the snapshots it sends
+    auto snapshot = Snapshot::alloc(0, frame);
+    spatialIndex->clear();
+    const auto& translations = snapshot->translations();
+    for (uint32_t i = 0; i < translations.size(); i++) {
+        spatialIndex->insert(i, translations[i]);
+    }
+    for (auto iter : views) {
+        auto view = iter.second;
+        auto relevant = view->relevant(snapshot, spatialIndex);
+        auto stream = view->serialize(relevant);
+        bytesSent += stream->size();
+        server->send(iter.first, DeliveryType::SEQUENCED, stream);
+    }
+    server->flush();
+}
+
+void client_tick(Bot& bot)
+{
+    for (auto msg : bot.client->poll()) {
+        if (msg->type() != MessageType::DATA) {
+            continue;
+        }
+        auto stream = msg->stream();
+        uint8_t type = 0;
+        stream >> type;
+        if (type != PayloadType::SNAPSHOT) {
+            continue;
+        }
+        uint32_t baseId = 0;
+        stream >> baseId;
+        uint32_t inputAck = 0;
+        stream >> inputAck;
+        Snapshot::Shared base = nullptr;
+        if (baseId != 0) {
+            base = bot.snapshots->find(baseId);
+            if (!base) {
+                continue;
+            }
+        }
+        auto snapshot = deserializeDelta(stream, base);
+        if (!snapshot) {
+            continue;
+        }
+        bot.snapshots->add(snapshot);
+        bot.client->send(DeliveryType::SEQUENCED, serialize_ack(snapshot->id()));
+    }
+    bot.client->flush();
+}
+
+int main(int argc, char** argv)
+{
+    if (parse_args(argc, argv)) {
+        LOG_INFO("Usage: benchmark [--clients N] [--ticks N]");
+        return 1;
+    }
+
+    std::srand(SEED);
+
+    frame = Frame::alloc();
+    spatialIndex = SpatialHash::alloc(INTEREST.nearRadius);
+    history = PlayerHistory::alloc(
+        Game::LAG_COMPENSATION_HISTORY / Game::STEP_DURATION + 1,
+        std::max(1u, numClients));
+
+    server = LoopbackServer::alloc();
+    if (server->start(PORT, std::max(1u, numClients))) {
+        return 1;
+    }
+
+    std::vector<Bot> bots(numClients);
+    for (auto& bot : bots) {
+        bot.client = LoopbackClient::alloc(server);
+        bot.snapshots = SnapshotHistory::alloc(Game::SNAPSHOT_HISTORY);
+        if (bot.client->connect("localhost", PORT)) {
+            return 1;
+        }
+    }
+
+    std::vector<std::time_t> serverTimes;
+    std::time_t clientTime = 0;
+    for (uint32_t i = 0; i < numTicks; i++) {
+        auto timestamp = Time::timestamp();
+        // simulated time, so the history spans the same ticks every run
+        server_tick((i + 1) * Game::STEP_DURATION);
+        serverTimes.push_back(Time::timestamp() - timestamp);
+        timestamp = Time::timestamp();
+        for (auto& bot : bots) {
+            client_tick(bot);
+        }
+        clientTime += Time::timestamp() - timestamp;
+    }
+
+    std::sort(serverTimes.begin(), serverTimes.end());
+    std::time_t total = 0;
+    for (auto time : serverTimes) {
+        total += time;
+    }
+    LOG_INFO(numTicks
+        << " ticks with "
+        << numClients
+        << " clients");
+    LOG_INFO("Server tick mean "
+        << Time::format(total / numTicks)
+        << ", p50 "
+        << Time::format(serverTimes[numTicks / 2])
+        << ", p99 "
+        << Time::format(serverTimes[numTicks * 99 / 100])
+        << ", max "
+        << Time::format(serverTimes.back()));
+    LOG_INFO("Client ticks mean "
+        << Time::format(clientTime / numTicks));
+    LOG_INFO("Sent "
+        << bytesSent / numTicks
+        << " snapshot bytes per tick");
+    LOG_INFO("Rewound raycast mean "
+        << (numRewinds > 0 ? float64_t(rewindTime) / numRewinds : 0)
+        << "μs against "
+        << history->size()
+        << " bytes of history");
+
+    for (auto& bot : bots) {
+        bot.client->disconnect();
+    }
+    server->stop();
+}
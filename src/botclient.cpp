@@ -0,0 +1,376 @@
+#include "Common.h"
+#include "enet/ENetClient.h"
+#include "game/Game.h"
+#include "game/InputBuffer.h"
+#include "game/InputType.h"
+#include "game/PayloadType.h"
+#include "game/Snapshot.h"
+#include "game/SnapshotHistory.h"
+#include "input/Input.h"
+#include "log/Log.h"
+#include "net/Compression.h"
+#include "net/DeliveryType.h"
+#include "net/Message.h"
+#include "serial/StreamBuffer.h"
+#include "time/Time.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Headless load generator, connects many bots to a server and reports what
+// they receive.
+
+const std::string HOST = "localhost";
+const uint32_t PORT = 7000;
+// how often the bots are serviced, about a rendering client's frame rate
+const std::time_t BOT_STEP = Time::fromSeconds(1.0 / 60.0);
+// bots change what they are doing at random intervals in this range
+const std::time_t MIN_INPUT_INTERVAL = Time::fromMilliseconds(250);
+const std::time_t MAX_INPUT_INTERVAL = Time::fromMilliseconds(2000);
+// distance from the origin of the scripted move targets
+const float32_t MOVE_RANGE = 20.0;
+const std::time_t REPORT_INTERVAL = Time::fromSeconds(1);
+
+// set from the signal handler, so only ever written as a sig_atomic_t
+volatile std::sig_atomic_t quit = false;
+
+// command line options
+std::string host = HOST;
+uint32_t port = PORT;
+uint32_t numShards = 1;
+uint32_t numBots = 16;
+std::time_t duration = Time::fromSeconds(30);
+Compression compression = Compression::NONE;
+
+struct Bot {
+    Bot()
+        : id(0)
+        , hasId(false)
+        , connected(false)
+        , nextInput(0)
+        , lastInputSend(0)
+        , lastSnapshot(0)
+        , stepDuration(Game::STEP_DURATION)
+    {
+    }
+    Client::Shared client;
+    SnapshotHistory::Shared snapshots;
+    InputBuffer::Shared inputs;
+    uint32_t id;
+    bool hasId;
+    bool connected;
+    std::time_t nextInput;
+    std::time_t lastInputSend;
+    // id of the newest snapshot decoded
+    uint32_t lastSnapshot;
+    // duration of the server's steps, as told by it on connecting
+    std::time_t stepDuration;
+};
+
+std::vector<Bot> bots;
+
+// results
+std::vector<std::time_t> snapshotLatencies;
+std::vector<std::time_t> requestLatencies;
+uint64_t numSnapshots = 0;
+uint64_t numMissed = 0;
+uint64_t numDiscarded = 0;
+uint32_t maxGap = 0;
+uint64_t numInputs = 0;
+uint32_t numDisconnects = 0;
+
+bool parse_args(int32_t argc, char** argv)
+{
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value for argument `" << arg << "`");
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--host") {
+            host = value;
+        } else if (arg == "--port") {
+            port = std::stoul(value);
+        } else if (arg == "--shards") {
+            numShards = std::max(1ul, std::stoul(value));
+        } else if (arg == "--bots") {
+            numBots = std::max(1ul, std::stoul(value));
+        } else if (arg == "--duration") {
+            duration = Time::fromSeconds(std::stod(value));
+        } else if (arg == "--compression") {
+            if (parseCompression(value, compression)) {
+                LOG_ERROR("Unknown compression `" << value << "`");
+                return 1;
+            }
+        } else {
+            LOG_ERROR("Unknown argument `" << arg << "`");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void signal_handler(int32_t signal)
+{
+    LOG_DEBUG("Caught signal: " << signal << ", shutting down...");
+    quit = true;
+}
+
+uint32_t pick_port()
+{
+    // spread bots across the ports of a sharded server
+    return port + (std::rand() % numShards);
+}
+
+std::time_t random_interval()
+{
+    return MIN_INPUT_INTERVAL + std::rand() % (MAX_INPUT_INTERVAL - MIN_INPUT_INTERVAL);
+}
+
+float32_t random_range(float32_t range)
+{
+    return (std::rand() / float32_t(RAND_MAX) * 2.0 - 1.0) * range;
+}
+
+std::time_t percentile(const std::vector<std::time_t>& sorted, float64_t p)
+{
+    if (sorted.empty()) {
+        return 0;
+    }
+    return sorted[std::min(sorted.size() - 1, size_t(sorted.size() * p))];
+}
+
+StreamBuffer::Shared serialize_ack(uint32_t snapshotId)
+{
+    auto stream = StreamBuffer::alloc();
+    stream << uint8_t(PayloadType::SNAPSHOT_ACK);
+    stream << snapshotId;
+    return stream;
+}
+
+void request_client_info(Bot& bot)
+{
+    auto sent = Time::timestamp();
+    bot.client->request(Net::CLIENT_INFO, nullptr, [&bot, sent](Message::Shared res) {
+        if (!res) {
+            LOG_ERROR("Failed to receive client info from server");
+            return;
+        }
+        requestLatencies.push_back(Time::timestamp() - sent);
+        auto stream = res->stream();
+        uint32_t tickRate = 0;
+        stream >> bot.id;
+        stream >> tickRate;
+        bot.hasId = true;
+        bot.stepDuration = Time::fromRate(std::max(1u, tickRate));
+    });
+}
+
+void add_input(Bot& bot)
+{
+    // alternate between clicking somewhere and holding a direction
+    Input::Shared input;
+    if (std::rand() % 2) {
+        input = Input::alloc(InputType::MOVE_TO);
+        input->emplace("position", glm::vec3(random_range(MOVE_RANGE), 0, random_range(MOVE_RANGE)));
+    } else {
+        input = Input::alloc(InputType::MOVE_DIRECTION);
+        input->emplace("direction", glm::vec3(random_range(1.0), 0, random_range(1.0)));
+    }
+    bot.inputs->add(input);
+    numInputs++;
+}
+
+void receive_snapshot(Bot& bot, StreamBuffer::Shared stream, std::time_t now)
+{
+    // find the baseline the delta was written against
+    uint32_t baseId = 0;
+    stream >> baseId;
+    // drop the inputs the server has received
+    uint32_t inputAck = 0;
+    stream >> inputAck;
+    bot.inputs->ack(inputAck);
+    Snapshot::Shared base = nullptr;
+    if (baseId != 0) {
+        base = bot.snapshots->find(baseId);
+        if (!base) {
+            numDiscarded++;
+            return;
+        }
+    }
+    auto snapshot = deserializeDelta(stream, base);
+    if (!snapshot) {
+        numDiscarded++;
+        return;
+    }
+    bot.snapshots->add(snapshot);
+    // NOTE: only meaningful when the server runs on the same machine
+    snapshotLatencies.push_back(now - snapshot->timestamp());
+    // the server numbers each client's snapshots consecutively, whatever
+    // its send rate, so skipped ids are lost
+    if (bot.lastSnapshot != 0) {
+        uint32_t gap = snapshot->id() - bot.lastSnapshot - 1;
+        numMissed += gap;
+        maxGap = std::max(maxGap, gap);
+    }
+    bot.lastSnapshot = snapshot->id();
+    numSnapshots++;
+    // acknowledge so the server can use it as the next baseline
+    bot.client->send(DeliveryType::SEQUENCED, serialize_ack(snapshot->id()));
+}
+
+void update_bot(Bot& bot, std::time_t now)
+{
+    if (!bot.connected) {
+        return;
+    }
+    for (auto msg : bot.client->poll()) {
+        switch (msg->type()) {
+        case MessageType::DISCONNECT:
+            LOG_WARN("Bot lost its connection to the server");
+            bot.connected = false;
+            bot.inputs->clear();
+            numDisconnects++;
+            return;
+
+        case MessageType::DATA:
+            auto stream = msg->stream();
+            uint8_t type = 0;
+            stream >> type;
+            if (type == PayloadType::SNAPSHOT) {
+                receive_snapshot(bot, stream, now);
+            }
+            break;
+        }
+    }
+    bool added = false;
+    if (bot.hasId && now >= bot.nextInput) {
+        add_input(bot);
+        bot.nextInput = now + random_interval();
+        added = true;
+    }
+    // batch the inputs as the client does
+    if (added || (!bot.inputs->empty() && now - bot.lastInputSend >= Game::INPUT_RESEND_STEPS * bot.stepDuration)) {
+        // bots run beside the server, so share its clock
+        bot.client->send(DeliveryType::UNRELIABLE, bot.inputs->serialize(now - Game::INTERPOLATION_STEPS * bot.stepDuration));
+        bot.lastInputSend = now;
+    }
+    bot.client->flush();
+}
+
+void report(std::time_t elapsed)
+{
+    std::sort(snapshotLatencies.begin(), snapshotLatencies.end());
+    std::sort(requestLatencies.begin(), requestLatencies.end());
+    uint64_t bytesReceived = 0;
+    for (const auto& bot : bots) {
+        bytesReceived += bot.client->stats().bytesReceived;
+    }
+    float64_t seconds = Time::toSeconds(elapsed);
+    LOG_INFO(bots.size()
+        << " bots for "
+        << Time::format(elapsed)
+        << ", "
+        << numDisconnects
+        << " disconnected");
+    LOG_INFO("Received "
+        << numSnapshots
+        << " snapshots ("
+        << numSnapshots / seconds
+        << "/s), "
+        << bytesReceived / seconds
+        << " bytes/s, sent "
+        << numInputs
+        << " inputs");
+    LOG_INFO("Snapshot latency p50 "
+        << Time::format(percentile(snapshotLatencies, 0.5))
+        << ", p90 "
+        << Time::format(percentile(snapshotLatencies, 0.9))
+        << ", p99 "
+        << Time::format(percentile(snapshotLatencies, 0.99))
+        << ", max "
+        << Time::format(percentile(snapshotLatencies, 1.0)));
+    LOG_INFO("Client info latency p50 "
+        << Time::format(percentile(requestLatencies, 0.5))
+        << ", p99 "
+        << Time::format(percentile(requestLatencies, 0.99)));
+    LOG_INFO("Missed "
+        << numMissed
+        << " snapshots, longest gap "
+        << maxGap
+        << ", discarded "
+        << numDiscarded
+        << " without a baseline");
+}
+
+int main(int argc, char** argv)
+{
+    if (parse_args(argc, argv)) {
+        LOG_INFO("Usage: botclient [--host HOST] [--port N] [--shards N] [--bots N] [--duration SECONDS] [--compression none|range|adaptive]");
+        return 1;
+    }
+
+    std::srand(std::time(0));
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGQUIT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    // NOTE: bots are serviced on this thread, a network thread per bot
+    // wouldn't scale to hundreds of them
+    bots = std::vector<Bot>(numBots);
+    for (auto& bot : bots) {
+        bot.client = ENetClient::alloc(false);
+        bot.client->setCompression(compression);
+        bot.snapshots = SnapshotHistory::alloc(Game::SNAPSHOT_HISTORY);
+        bot.inputs = InputBuffer::alloc(Game::INPUT_REDUNDANCY);
+        if (bot.client->connect(host, pick_port())) {
+            LOG_ERROR("Bot failed to connect");
+            continue;
+        }
+        bot.connected = true;
+        bot.nextInput = Time::timestamp() + random_interval();
+        request_client_info(bot);
+    }
+
+    auto start = Time::timestamp();
+    auto lastReport = start;
+
+    while (!quit) {
+
+        std::time_t now = Time::timestamp();
+        if (now - start >= duration) {
+            break;
+        }
+
+        for (auto& bot : bots) {
+            update_bot(bot, now);
+        }
+
+        if (now - lastReport >= REPORT_INTERVAL) {
+            LOG_INFO("Received "
+                << numSnapshots
+                << " snapshots, missed "
+                << numMissed);
+            lastReport = now;
+        }
+
+        // sleep until next step
+        std::time_t elapsed = Time::timestamp() - now;
+        if (elapsed < BOT_STEP) {
+            Time::sleep(BOT_STEP - elapsed);
+        }
+    }
+
+    report(Time::timestamp() - start);
+
+    for (auto& bot : bots) {
+        bot.client->disconnect();
+    }
+}
@@ -1,10 +1,17 @@
 #include "Common.h"
 #include "enet/ENetClient.h"
+#include "enet/StatsExporter.h"
 #include "game/Camera.h"
 #include "game/Environment.h"
 #include "game/Frame.h"
 #include "game/Game.h"
+#include "game/InputBuffer.h"
 #include "game/InputType.h"
+#include "game/InterpolationDelay.h"
+#include "game/PayloadType.h"
+#include "game/Prediction.h"
+#include "game/Snapshot.h"
+#include "game/SnapshotHistory.h"
 #include "geometry/Cube.h"
 #include "gl/ElementArrayBufferObject.h"
 #include "gl/GLCommon.h"
@@ -16,12 +23,16 @@
 #include "gl/VertexFragmentShader.h"
 #include "log/Log.h"
 #include "math/Transform.h"
+#include "net/Compression.h"
 #include "net/DeliveryType.h"
 #include "net/Message.h"
+#include "net/NetworkConditions.h"
+#include "net/SimulatedClient.h"
 #include "render/RenderCommand.h"
 #include "render/Renderer.h"
 #include "sdl/SDL2Window.h"
 #include "serial/StreamBuffer.h"
+#include "time/ClockSync.h"
 #include "time/Time.h"
 
 #include <glm/ext.hpp>
@@ -40,11 +51,31 @@ const std::time_t DISCONNECT_TIMEOUT = Time::fromSeconds(5);
 
 bool quit = false;
 
+// command line options
+std::string host = HOST;
+uint32_t port = PORT;
+uint32_t numShards = 1;
+Compression compression = Compression::NONE;
+// where to export connection statistics, if anywhere
+std::string statsTarget;
+// impairments to apply to everything sent, if any
+bool simulate = false;
+NetworkConditions conditions;
+// bounds of the interpolation delay, 0 to follow the server's step duration
+std::time_t minDelay = 0;
+std::time_t maxDelay = 0;
+// snapshots per second to ask the server for, 0 leaves it to the server
+uint32_t sendRate = 0;
+
 Window::Shared window;
 Keyboard::Shared keyboard;
 Mouse::Shared mouse;
-Player::Shared player;
+Transform::Shared player;
 uint32_t id = 0;
+// whether the server has told us our id yet
+bool hasId = false;
+// duration of the server's steps, as told by it on connecting
+std::time_t stepDuration = Game::STEP_DURATION;
 
 VertexFragmentShader::Shared flatShader;
 VertexFragmentShader::Shared phongShader;
@@ -59,6 +90,17 @@ Client::Shared client;
 Camera::Shared camera;
 
 std::deque<Frame::Shared> frames;
+SnapshotHistory::Shared snapshots;
+// inputs not yet acknowledged by the server
+InputBuffer::Shared inputs;
+std::time_t lastInputSend = 0;
+// offset of the server's clock, frames are timestamped by it
+ClockSync::Shared serverClock;
+std::time_t lastClockSync = 0;
+// how far behind the server frames are rendered
+InterpolationDelay::Shared interpolationDelay;
+// the local player ahead of the server
+Prediction::Shared prediction;
 Environment::Shared environment;
 
 void add_frame(Frame::Shared frame)
@@ -221,21 +263,158 @@ std::vector<RenderCommand::Shared> render_terrain(Terrain::Shared terrain)
     return commands;
 }
 
+bool parse_args(int32_t argc, char** argv)
+{
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value for argument `" << arg << "`");
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--host") {
+            host = value;
+        } else if (arg == "--port") {
+            port = std::stoul(value);
+        } else if (arg == "--shards") {
+            numShards = std::max(1ul, std::stoul(value));
+        } else if (arg == "--compression") {
+            if (parseCompression(value, compression)) {
+                LOG_ERROR("Unknown compression `" << value << "`");
+                return 1;
+            }
+        } else if (arg == "--stats") {
+            statsTarget = value;
+        } else if (arg == "--simulate") {
+            if (parseConditions(value, conditions)) {
+                return 1;
+            }
+            simulate = true;
+        } else if (arg == "--send-rate") {
+            sendRate = std::stoul(value);
+        } else if (arg == "--min-delay") {
+            minDelay = Time::fromMilliseconds(std::stod(value));
+        } else if (arg == "--max-delay") {
+            maxDelay = Time::fromMilliseconds(std::stod(value));
+        } else {
+            LOG_ERROR("Unknown argument `" << arg << "`");
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint32_t pick_port()
+{
+    // spread clients across the ports of a sharded server
+    return port + (std::rand() % numShards);
+}
+
 void signal_handler(int32_t signal)
 {
     LOG_DEBUG("Caught signal: " << signal << ", shutting down...");
     quit = true;
 }
 
+void load_interpolation_delay()
+{
+    // the bounds follow the server's steps unless they were given
+    interpolationDelay = InterpolationDelay::alloc(
+        stepDuration,
+        minDelay > 0 ? minDelay : Game::MIN_INTERPOLATION_STEPS * stepDuration,
+        maxDelay > 0 ? maxDelay : Game::MAX_INTERPOLATION_STEPS * stepDuration);
+}
+
+void request_client_info()
+{
+    hasId = false;
+    StreamBuffer::Shared req = nullptr;
+    if (sendRate > 0) {
+        req = StreamBuffer::alloc();
+        req << sendRate;
+    }
+    client->request(Net::CLIENT_INFO, req, [](Message::Shared res) {
+        if (!res) {
+            LOG_ERROR("Failed to receive client info from server");
+            return;
+        }
+        auto stream = res->stream();
+        uint32_t tickRate = 0;
+        uint32_t rate = 0;
+        stream >> id;
+        stream >> tickRate;
+        stream >> rate;
+        hasId = true;
+        // replay inputs in the steps the server takes, and measure the
+        // interpolation delay against them
+        stepDuration = Time::fromRate(std::max(1u, tickRate));
+        prediction->setStepDuration(stepDuration);
+        load_interpolation_delay();
+        LOG_INFO("player id is "
+            << id
+            << ", server steps at "
+            << tickRate
+            << "Hz and sends at "
+            << rate
+            << "Hz");
+    });
+}
+
+void request_time()
+{
+    auto sent = Time::timestamp();
+    client->request(Net::TIME_SYNC, nullptr, [sent](Message::Shared res) {
+        if (!res) {
+            // lost, the next one will do
+            return;
+        }
+        std::time_t server = 0;
+        auto stream = res->stream();
+        stream >> server;
+        serverClock->add(sent, server, Time::timestamp());
+    });
+}
+
+void sync_clock(std::time_t now)
+{
+    // sample quickly until there are enough to trust
+    auto interval = serverClock->synced() ? Game::CLOCK_SYNC_INTERVAL : stepDuration;
+    if (now - lastClockSync >= interval) {
+        request_time();
+        lastClockSync = now;
+    }
+}
+
+std::time_t view_time(std::time_t now)
+{
+    // the server time the interpolated frames are drawn at
+    return serverClock->serverTime(now) - interpolationDelay->delay();
+}
+
+std::time_t predicted_time(std::time_t now)
+{
+    // where the server will be when an input sent now arrives
+    return serverClock->serverTime(now) + serverClock->roundTripTime() / 2;
+}
+
 void handle_disconnect()
 {
+    // baselines are only valid for a single connection
+    snapshots->clear();
+    // the new connection has a new view of our inputs
+    inputs->clear();
+    // the server may have restarted on another machine
+    serverClock->clear();
+    interpolationDelay->clear();
+    prediction->clear();
     // sleep
     Time::sleep(DISCONNECT_TIMEOUT);
     // attempt to reconnect
     while (!quit) {
         LOG_DEBUG("Attempting to re-connect to server...");
-        if (!client->connect(HOST, PORT)) {
-            // success
+        if (!client->connect(host, pick_port())) {
+            // success, our id is only valid for a single connection
+            request_client_info();
             break;
         }
     }
@@ -250,19 +429,49 @@ void update_view()
     camera->setAspect(float32_t(size.x) / float32_t(size.y));
 }
 
-void deserialize_frame(StreamBuffer::Shared stream)
+StreamBuffer::Shared serialize_ack(uint32_t snapshotId)
 {
-    auto frame = Frame::alloc();
-    stream >> frame;
-    add_frame(frame);
-    return;
+    auto stream = StreamBuffer::alloc();
+    stream << uint8_t(PayloadType::SNAPSHOT_ACK);
+    stream << snapshotId;
+    return stream;
 }
 
-StreamBuffer::Shared serialize_input(Input::Shared input)
+void deserialize_snapshot(StreamBuffer::Shared stream, std::time_t now)
 {
-    auto stream = StreamBuffer::alloc();
-    stream << input;
-    return stream;
+    // find the baseline the delta was written against
+    uint32_t baseId = 0;
+    stream >> baseId;
+    // drop the inputs the server has received
+    uint32_t inputAck = 0;
+    stream >> inputAck;
+    inputs->ack(inputAck);
+    Snapshot::Shared base = nullptr;
+    if (baseId != 0) {
+        base = snapshots->find(baseId);
+        if (!base) {
+            LOG_WARN("Baseline snapshot " << baseId << " no longer available, discarding delta");
+            return;
+        }
+    }
+    auto snapshot = deserializeDelta(stream, base);
+    if (!snapshot) {
+        LOG_WARN("Malformed snapshot delta, discarding");
+        return;
+    }
+    snapshots->add(snapshot);
+    auto frame = snapshot->frame();
+    add_frame(frame);
+    if (serverClock->synced()) {
+        // measure how late it is compared to what we already have
+        interpolationDelay->add(frame->timestamp(), serverClock->serverTime(now));
+        // correct the prediction against the server's state of our player
+        if (hasId) {
+            prediction->reconcile(frame, id, inputAck, environment, predicted_time(now));
+        }
+    }
+    // acknowledge so the server can use it as the next baseline
+    client->send(DeliveryType::SEQUENCED, serialize_ack(snapshot->id()));
 }
 
 std::tuple<Frame::Shared, Frame::Shared, float32_t> get_frames(std::time_t now)
@@ -290,16 +499,17 @@ std::tuple<Frame::Shared, Frame::Shared, float32_t> get_frames(std::time_t now)
     //                            |
     //                    interpolation delay
 
-    // we need at least 2 frames
-    if (frames.size() < 2) {
+    // we need at least 2 frames, and to know the server's time
+    if (frames.size() < 2 || !serverClock->synced()) {
         return std::make_tuple(nullptr, nullptr, 0);
     }
 
     // get last frame index
     int32_t lastFrameIndex = int32_t(frames.size()) - 1;
 
-    // delay timestamp for interpolation "window"
-    auto delayed = now - Game::INTERPOLATION_DELAY;
+    // delay timestamp for interpolation "window", frames are stamped with the
+    // server's clock so the window is too
+    auto delayed = view_time(now);
 
     // find closest frames on each side of the current time
 
@@ -368,13 +578,23 @@ void process_frame(std::time_t now, std::time_t last)
     // process events
     window->processEvents();
 
-    // poll for input
+    // poll for input, applying it to the local player straight away
     auto input = window->poll();
-    // send input to server
+    auto predicted = predicted_time(now);
     for (auto i : input) {
-        client->send(DeliveryType::RELIABLE, serialize_input(i));
+        prediction->add(inputs->add(i), i, predicted);
     }
-    // TODO: interpolate from input
+    // send the frame's inputs in a single batch along with any the server
+    // hasn't acknowledged, resending those every so often when idle
+    if (!input.empty() || (!inputs->empty() && now - lastInputSend >= Game::INPUT_RESEND_STEPS * stepDuration)) {
+        client->send(DeliveryType::UNRELIABLE, inputs->serialize(view_time(now)));
+        lastInputSend = now;
+    }
+    // advance the local player without waiting for the server
+    prediction->update(environment, predicted);
+
+    // follow the measured link
+    interpolationDelay->update(now - last);
 
     // get frames to interpolate between
     Frame::Shared a, b;
@@ -392,9 +612,18 @@ void process_frame(std::time_t now, std::time_t last)
     // interpolate frame
     auto frame = interpolate(a, b, t);
 
-    player = frame->player(id);
+    player = nullptr;
+    if (hasId) {
+        // draw our player where it is predicted to be, falling back to the
+        // server's until there is a prediction
+        player = prediction->player();
+        int32_t index = frame->find(id);
+        if (!player && index >= 0) {
+            player = frame->transform(index);
+        }
+        frame->remove(id);
+    }
     if (player) {
-        frame->removePlayer(id);
         camera->follow(player);
     }
 
@@ -411,14 +640,13 @@ void process_frame(std::time_t now, std::time_t last)
     }
 
     // draw other players
-    for (auto iter : frame->players()) {
-        auto player = iter.second;
-        Renderer::render(render_phong(cube, player->transform()->matrix()));
+    for (uint32_t i = 0; i < frame->size(); i++) {
+        Renderer::render(render_phong(cube, frame->matrix(i)));
     }
 
     // draw player
     if (player) {
-        Renderer::render(render_phong(cube, player->transform()->matrix()));
+        Renderer::render(render_phong(cube, player->matrix()));
     }
 
     // draw origin
@@ -446,6 +674,10 @@ Input::Shared move_to_click(
     const std::map<Button, ButtonState>& mouseState,
     const std::map<Key, KeyState>& keyboardState)
 {
+    if (!player) {
+        // no player to move until the server has told us our id
+        return nullptr;
+    }
     if (event.button == Button::LEFT && (event.type == ButtonEvent::CLICK || event.type == ButtonEvent::RELEASE)) {
         auto size = window->size();
         auto direction = camera->mouseToWorld(event.position, size.x, size.y);
@@ -455,7 +687,7 @@ Input::Shared move_to_click(
             Input::Shared input = nullptr;
             if (event.type == ButtonEvent::CLICK) {
                 input = Input::alloc(InputType::MOVE_DIRECTION);
-                input->emplace("direction", intersection.position - player->transform()->translation());
+                input->emplace("direction", intersection.position - player->translation());
             } else {
                 input = Input::alloc(InputType::MOVE_TO);
                 input->emplace("position", intersection.position);
@@ -472,17 +704,21 @@ Input::Shared move_to_hold(
     const std::map<Button, ButtonState>& mouseState,
     const std::map<Key, KeyState>& keyboardState)
 {
+    if (!player) {
+        // no player to move until the server has told us our id
+        return nullptr;
+    }
     auto button = get(mouseState, Button::LEFT);
     if (button == ButtonState::DOWN) {
         auto now = Time::timestamp();
-        if (now - last > Game::STEP_DURATION) {
+        if (now - last > stepDuration) {
             auto size = window->size();
             auto direction = camera->mouseToWorld(event.position, size.x, size.y);
             auto origin = camera->transform()->translation();
             auto intersection = environment->intersect(direction, origin);
             if (intersection.hit) {
                 auto input = Input::alloc(InputType::MOVE_DIRECTION);
-                input->emplace("direction", intersection.position - player->transform()->translation());
+                input->emplace("direction", intersection.position - player->translation());
                 last = now;
                 return input;
             }
@@ -634,6 +870,11 @@ void load_environment()
 int main(int argc, char** argv)
 {
 
+    if (parse_args(argc, argv)) {
+        LOG_INFO("Usage: client [--host HOST] [--port N] [--shards N] [--compression none|range|adaptive] [--stats file:PATH|udp:HOST:PORT] [--simulate latency=MS,jitter=MS,loss=%,duplicate=%,reorder=%,bandwidth=KBPS,seed=N] [--min-delay MS] [--max-delay MS] [--send-rate HZ]");
+        return 1;
+    }
+
     std::srand(std::time(0));
 
     // TODO: put this in window class?
@@ -660,27 +901,44 @@ int main(int argc, char** argv)
     load_axes();
     load_environment();
 
-    client = ENetClient::alloc();
+    // service the network on its own thread so it doesn't wait on rendering
+    client = ENetClient::alloc(true);
+    client->setCompression(compression);
+    if (simulate) {
+        // impair everything the client sends
+        client = SimulatedClient::alloc(client, conditions);
+    }
+    snapshots = SnapshotHistory::alloc(Game::SNAPSHOT_HISTORY);
+    inputs = InputBuffer::alloc(Game::INPUT_REDUNDANCY);
+    serverClock = ClockSync::alloc();
+    load_interpolation_delay();
+    prediction = Prediction::alloc();
 
-    if (client->connect(HOST, PORT)) {
+    if (client->connect(host, pick_port())) {
         return 1;
     }
 
-    auto msg = client->request(Net::CLIENT_INFO, nullptr);
-    if (!msg) {
-        return 1;
-    } else {
-        auto stream = msg->stream();
-        stream >> id;
-        LOG_INFO("player id is " << id);
+    // the response is handled while polling
+    request_client_info();
+
+    StatsExporter::Shared exporter;
+    if (!statsTarget.empty()) {
+        exporter = StatsExporter::alloc();
+        if (exporter->open(statsTarget)) {
+            return 1;
+        }
     }
 
     std::time_t last = Time::timestamp();
+    std::time_t lastExport = last;
 
     while (!window->shouldClose() && !quit) {
 
         std::time_t now = Time::timestamp();
 
+        // keep track of the server's clock
+        sync_clock(now);
+
         // process the frame
         process_frame(now, last);
 
@@ -703,11 +961,25 @@ int main(int argc, char** argv)
 
                 // handle message
                 auto stream = msg->stream();
-                deserialize_frame(stream);
+                uint8_t type = 0;
+                stream >> type;
+                if (type == PayloadType::SNAPSHOT) {
+                    deserialize_snapshot(stream, now);
+                }
                 break;
             }
         }
 
+        // send everything queued this frame at once
+        client->flush();
+
+        // export the connection statistics
+        if (exporter && now - lastExport >= STATS_INTERVAL) {
+            exporter->write(now, client->stats());
+            exporter->write(now, client->compressionStats());
+            lastExport = now;
+        }
+
         // check if exit
         if (quit) {
             break;
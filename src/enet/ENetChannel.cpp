@@ -0,0 +1,44 @@
+#include "enet/ENetChannel.h"
+
+void getChannel(DeliveryType type, uint8_t& channel, uint32_t& flags)
+{
+    switch (type) {
+    case DeliveryType::RELIABLE:
+        channel = RELIABLE_CHANNEL;
+        flags = ENET_PACKET_FLAG_RELIABLE;
+        break;
+    case DeliveryType::UNRELIABLE:
+        channel = UNRELIABLE_CHANNEL;
+        flags = ENET_PACKET_FLAG_UNSEQUENCED;
+        break;
+    case DeliveryType::SEQUENCED:
+        // NOTE: sequenced packets larger than the MTU are fragmented
+        // unreliably rather than falling back to reliable fragments
+        channel = SEQUENCED_CHANNEL;
+        flags = ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT;
+        break;
+    }
+}
+
+static void freePacket(ENetPacket* packet)
+{
+    // release the message that owns the packet data
+    delete static_cast<Message::Shared*>(packet->userData);
+    packet->userData = nullptr;
+}
+
+ENetPacket* createPacket(const Message::Shared& msg, uint32_t flags)
+{
+    size_t numBytes = 0;
+    const uint8_t* data = msg->serialize(numBytes);
+    ENetPacket* packet = enet_packet_create(
+        data,
+        numBytes,
+        flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    if (!packet) {
+        return nullptr;
+    }
+    packet->userData = new Message::Shared(msg);
+    packet->freeCallback = freePacket;
+    return packet;
+}
@@ -1,24 +1,39 @@
 #include "enet/ENetClient.h"
 
 #include "Common.h"
+#include "enet/ENetChannel.h"
 #include "log/Log.h"
 #include "time/Time.h"
 
 const uint8_t SERVER_ID = 0;
 const std::time_t TIMEOUT_MS = 5000;
-const std::time_t REQUEST_INTERVAL = Time::fromSeconds(1.0 / 60.0);
-const uint8_t RELIABLE_CHANNEL = 0;
-const uint8_t UNRELIABLE_CHANNEL = 1;
-const uint8_t NUM_CHANNELS = 2;
+// how long the network thread waits for incoming packets before checking the
+// outbound queue again
+const uint32_t SERVICE_TIMEOUT_MS = 1;
+// number of messages that can be waiting in each direction
+const size_t QUEUE_CAPACITY = 1024;
 
-ENetClient::Shared ENetClient::alloc()
+ENetClient::Shared ENetClient::alloc(bool threaded)
 {
-    return std::make_shared<ENetClient>();
+    return std::make_shared<ENetClient>(threaded);
 }
 
-ENetClient::ENetClient()
+ENetClient::ENetClient(bool threaded)
     : host_(nullptr)
+    , server_(nullptr)
+    , requests_(RequestTable::alloc())
+    , compressor_(PacketCompressor::alloc(Compression::NONE))
     , currentMsgId_(0)
+    , numQueued_(0)
+    , sequence_(0)
+    , hasSequence_(false)
+    , threaded_(threaded)
+    , running_(false)
+    , connected_(false)
+    , numSent_(0)
+    , inbound_(QUEUE_CAPACITY)
+    , outbound_(QUEUE_CAPACITY)
+    , lastSample_(0)
 {
     // initialize enet
     // TODO: prevent this from being called multiple times
@@ -37,7 +52,10 @@ ENetClient::ENetClient()
     // NOTE: this only fails if malloc fails inside `enet_host_create`
     if (host_ == nullptr) {
         LOG_ERROR("An error occurred while trying to create an ENet client host");
+        return;
     }
+    // compress outgoing datagrams
+    compressor_->install(host_);
 }
 
 ENetClient::~ENetClient()
@@ -58,12 +76,19 @@ bool ENetClient::connect(const std::string& host, uint32_t port)
         LOG_DEBUG("ENetClient is already connected to a server");
         return 0;
     }
+    // the network thread exits once the connection is lost
+    stopThread();
+    // discard anything received on the previous connection
+    Message::Shared msg;
+    while (inbound_.pop(msg)) {
+    }
     // set address to connect to
     ENetAddress address;
     enet_address_set_host(&address, host.c_str());
     address.port = port;
-    // initiate the connection, allocating the two channels 0 and 1.
-    server_ = enet_host_connect(host_, &address, NUM_CHANNELS, 0);
+    // initiate the connection, allocating the two channels 0 and 1. The
+    // codecs we can decompress are sent along so the server can check them
+    server_ = enet_host_connect(host_, &address, NUM_CHANNELS, PacketCompressor::supported());
     if (server_ == nullptr) {
         LOG_ERROR("No available peers for initiating an ENet connection");
         return 1;
@@ -76,6 +101,19 @@ bool ENetClient::connect(const std::string& host, uint32_t port)
     if (enet_host_service(host_, &event, TIMEOUT_MS) > 0 && event.type == ENET_EVENT_TYPE_CONNECT) {
         // connection successful
         LOG_DEBUG("Connection to `" << host << ":" << port << "` succeeded");
+        sequence_ = 0;
+        hasSequence_ = false;
+        monitor_ = PeerMonitor();
+        {
+            std::lock_guard<std::mutex> lock(statsMutex_);
+            stats_ = PeerStats();
+        }
+        connected_ = true;
+        if (threaded_) {
+            // hand the host over to the network thread
+            running_ = true;
+            thread_ = std::thread(&ENetClient::run, this);
+        }
         return 0;
     }
     // failure to connect
@@ -88,8 +126,11 @@ bool ENetClient::connect(const std::string& host, uint32_t port)
 bool ENetClient::disconnect()
 {
     if (!isConnected()) {
+        stopThread();
         return 0;
     }
+    // take the host back from the network thread
+    stopThread();
     LOG_DEBUG("Disconnecting from server...");
     // attempt to gracefully disconnect
     enet_peer_disconnect(server_, 0);
@@ -126,12 +167,18 @@ bool ENetClient::disconnect()
         enet_peer_reset(server_);
     }
     server_ = nullptr;
+    connected_ = false;
+    hasSequence_ = false;
+    // fail any outstanding requests
+    requests_->clear();
     return !success;
 }
 
 bool ENetClient::isConnected() const
 {
-    return host_->connectedPeers > 0;
+    // NOTE: tracked separately from the host so that it can be read while the
+    // network thread owns the host
+    return connected_;
 }
 
 void ENetClient::on(uint32_t id, RequestHandler handler)
@@ -139,13 +186,34 @@ void ENetClient::on(uint32_t id, RequestHandler handler)
     handlers_[id] = handler;
 }
 
-void ENetClient::handleRequest(uint32_t requestId, StreamBuffer::Shared stream) const
+void ENetClient::setCompression(Compression type)
+{
+    if (isConnected()) {
+        LOG_WARN("Compression must be set before connecting");
+        return;
+    }
+    // the network thread has exited, so the host can be changed
+    stopThread();
+    compressor_ = PacketCompressor::alloc(type);
+    if (host_) {
+        compressor_->install(host_);
+    }
+}
+
+CompressionStats ENetClient::compressionStats() const
+{
+    return compressor_->stats();
+}
+
+void ENetClient::handleRequest(const Message::Shared& msg) const
 {
-    auto iter = handlers_.find(requestId);
+    auto iter = handlers_.find(msg->requestId());
     if (iter != handlers_.end()) {
         auto handler = iter->second;
-        auto res = handler(SERVER_ID, stream);
-        sendResponse(requestId, res);
+        auto res = handler(SERVER_ID, msg->stream());
+        // respond with the id of the request message so the server can match
+        // it against its outstanding requests
+        sendResponse(msg->id(), res);
     }
 }
 
@@ -165,29 +233,32 @@ void ENetClient::sendResponse(uint32_t requestId, StreamBuffer::Shared stream) c
 
 void ENetClient::sendMessage(DeliveryType type, Message::Shared msg) const
 {
-    uint32_t channel = 0;
-    uint32_t flags = 0;
-    if (type == DeliveryType::RELIABLE) {
-        channel = RELIABLE_CHANNEL;
-        flags = ENET_PACKET_FLAG_RELIABLE;
+    if (threaded_) {
+        // frame the message on the calling thread, a stream shared by
+        // several messages must not be framed by two threads at once
+        size_t numBytes = 0;
+        msg->serialize(numBytes);
+        // the network thread writes the packet
+        enqueue(Outbound(type, msg));
     } else {
-        channel = UNRELIABLE_CHANNEL;
-        flags = ENET_PACKET_FLAG_UNSEQUENCED;
+        writeMessage(type, msg);
     }
+    // NOTE: the packet is queued and sent with everything else on `flush`
+    numQueued_++;
+}
 
-    // get bytes
-    auto data = msg->serialize();
+void ENetClient::writeMessage(DeliveryType type, Message::Shared msg) const
+{
+    uint8_t channel = 0;
+    uint32_t flags = 0;
+    getChannel(type, channel, flags);
 
-    // create the packet
-    ENetPacket* p = enet_packet_create(
-        &data[0],
-        data.size(),
-        flags);
+    // create the packet, this references the message rather than copying it
+    ENetPacket* p = createPacket(msg, flags);
 
     // send the packet to the peer
+    monitor_.sent(p->dataLength);
     enet_peer_send(server_, channel, p);
-    // flush / send the packet queue
-    enet_host_flush(host_);
 }
 
 void ENetClient::send(DeliveryType type, StreamBuffer::Shared stream) const
@@ -203,7 +274,33 @@ void ENetClient::send(DeliveryType type, StreamBuffer::Shared stream) const
     sendMessage(type, msg);
 }
 
-void ENetClient::sendRequest(uint32_t requestId, StreamBuffer::Shared stream) const
+uint32_t ENetClient::flush()
+{
+    if (!isConnected()) {
+        return 0;
+    }
+    if (threaded_) {
+        // ask the network thread to flush, the datagrams it has sent since
+        // the last call are returned instead
+        enqueue(Outbound());
+        numQueued_ = 0;
+        return numSent_.exchange(0);
+    }
+    // send all queued packets, ENet coalesces them into as few datagrams as
+    // the MTU allows
+    auto before = host_->totalSentPackets;
+    enet_host_flush(host_);
+    auto sent = host_->totalSentPackets - before;
+    numQueued_ = 0;
+    return sent;
+}
+
+uint32_t ENetClient::numQueued() const
+{
+    return numQueued_;
+}
+
+uint32_t ENetClient::sendRequest(uint32_t requestId, StreamBuffer::Shared stream) const
 {
     auto msg = Message::alloc(
         ++currentMsgId_, // id
@@ -211,45 +308,78 @@ void ENetClient::sendRequest(uint32_t requestId, StreamBuffer::Shared stream) co
         MessageType::DATA_REQUEST,
         stream);
     sendMessage(DeliveryType::RELIABLE, msg);
+    return msg->id();
 }
 
-Message::Shared ENetClient::request(uint32_t requestId, StreamBuffer::Shared stream)
+void ENetClient::request(uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
 {
     if (!isConnected()) {
         LOG_DEBUG("ENetClient is not connected to any server");
-        return nullptr;
-    }
-    // send request
-    sendRequest(requestId, stream);
-    // wait for response
-    auto timestamp = Time::timestamp();
-    while (true) {
-        auto msgs = poll();
-        for (auto msg : msgs) {
-            if (msg->type() == MessageType::DATA_RESPONSE && msg->requestId() == requestId) {
-                return msg;
-            }
-            queue_.push_back(msg);
+        // fail immediately, there is no server to respond
+        if (handler) {
+            handler(nullptr);
         }
-        if (Time::timestamp() - timestamp > Time::fromMilliseconds(TIMEOUT_MS)) {
-            break;
-        }
-        Time::sleep(REQUEST_INTERVAL);
+        return;
     }
-    return nullptr;
+    auto msgId = sendRequest(requestId, stream);
+    requests_->add(msgId, SERVER_ID, handler, timeout);
 }
 
 std::vector<Message::Shared> ENetClient::poll()
 {
     std::vector<Message::Shared> msgs;
-    if (!isConnected()) {
-        LOG_DEBUG("ENetClient is not connected to any server");
-        return msgs;
+    if (threaded_) {
+        // take everything the network thread has received, this includes
+        // the disconnect if the connection was lost
+        Message::Shared msg;
+        while (inbound_.pop(msg)) {
+            msgs.push_back(msg);
+        }
+    } else if (isConnected()) {
+        service(msgs, 0);
+        sampleStats(Time::timestamp());
     }
+    return dispatch(msgs);
+}
+
+std::vector<Message::Shared> ENetClient::dispatch(const std::vector<Message::Shared>& received)
+{
+    std::vector<Message::Shared> msgs;
+    for (auto msg : received) {
+        switch (msg->type()) {
+        case MessageType::DATA_RESPONSE:
+            // complete outstanding requests
+            if (!requests_->resolve(msg)) {
+                LOG_DEBUG("Discarding response to unknown request "
+                    << msg->requestId());
+            }
+            break;
+        case MessageType::DATA_REQUEST:
+            msgs.push_back(msg);
+            handleRequest(msg);
+            break;
+        case MessageType::DISCONNECT:
+            msgs.push_back(msg);
+            // fail any requests the server can no longer respond to
+            requests_->clear();
+            break;
+        default:
+            msgs.push_back(msg);
+            break;
+        }
+    }
+    // fail any requests that have timed out
+    requests_->expire(Time::timestamp());
+    return msgs;
+}
+
+void ENetClient::service(std::vector<Message::Shared>& msgs, uint32_t timeout)
+{
     ENetEvent event;
     while (true) {
-        // poll with a zero timeout
-        int32_t res = enet_host_service(host_, &event, 0);
+        // only the first call waits, the rest drain what has already arrived
+        int32_t res = enet_host_service(host_, &event, timeout);
+        timeout = 0;
         if (res > 0) {
             // event occured
             if (event.type == ENET_EVENT_TYPE_RECEIVE) {
@@ -261,23 +391,33 @@ std::vector<Message::Shared> ENetClient::poll()
                 //     << "` was received on channel "
                 //     << event.channelID);
 
-                // convert message to stream
+                // view the packet payload rather than copying it, the
+                // packet is destroyed once the last message referencing it is
+                auto packet = std::shared_ptr<ENetPacket>(
+                    event.packet,
+                    enet_packet_destroy);
                 auto stream = StreamBuffer::alloc(
-                    event.packet->data,
-                    event.packet->dataLength);
+                    packet->data,
+                    packet->dataLength,
+                    packet);
 
                 // deserialize message
                 auto msg = Message::alloc(SERVER_ID);
                 msg->deserialize(stream);
-                msgs.push_back(msg);
+                monitor_.received(packet->dataLength);
 
-                // handle requests
-                if (msg->type() == MessageType::DATA_REQUEST) {
-                    handleRequest(msg->requestId(), msg->stream());
+                // drop stale or out-of-order sequenced messages
+                if (event.channelID == SEQUENCED_CHANNEL) {
+                    // ids are shared by every peer, so the first is
+                    // taken whatever it is
+                    if (hasSequence_ && !isNewer(msg->id(), sequence_)) {
+                        continue;
+                    }
+                    sequence_ = msg->id();
+                    hasSequence_ = true;
                 }
 
-                // destroy packet payload
-                enet_packet_destroy(event.packet);
+                msgs.push_back(msg);
 
             } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
                 // server disconnected
@@ -287,6 +427,9 @@ std::vector<Message::Shared> ENetClient::poll()
                     MessageType::DISCONNECT);
                 msgs.push_back(msg);
                 server_ = nullptr;
+                connected_ = false;
+                hasSequence_ = false;
+                break;
             }
         } else if (res < 0) {
             // error occured
@@ -297,9 +440,85 @@ std::vector<Message::Shared> ENetClient::poll()
             break;
         }
     }
-    if (!queue_.empty()) {
-        msgs.insert(msgs.end(), queue_.begin(), queue_.end());
-        queue_ = std::vector<Message::Shared>();
+}
+
+void ENetClient::enqueue(const Outbound& out) const
+{
+    // NOTE: if the network thread falls behind, wait for it rather than
+    // dropping reliable messages
+    while (!outbound_.push(out)) {
+        if (!running_) {
+            return;
+        }
+        std::this_thread::yield();
     }
-    return msgs;
+}
+
+void ENetClient::run()
+{
+    std::vector<Message::Shared> msgs;
+    while (running_ && isConnected()) {
+        auto before = host_->totalSentPackets;
+        // hold everything queued by the simulation thread until it flushes,
+        // otherwise servicing the host would send a frame's messages as they
+        // arrive rather than together
+        Outbound out;
+        while (outbound_.pop(out)) {
+            if (!out.msg) {
+                for (const auto& staged : staged_) {
+                    writeMessage(staged.type, staged.msg);
+                }
+                staged_.clear();
+                enet_host_flush(host_);
+            } else {
+                staged_.push_back(out);
+            }
+        }
+        // wait briefly for incoming packets
+        service(msgs, SERVICE_TIMEOUT_MS);
+        numSent_ += host_->totalSentPackets - before;
+        sampleStats(Time::timestamp());
+        // hand the received messages to the simulation thread
+        for (auto msg : msgs) {
+            while (!inbound_.push(msg)) {
+                if (!running_) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+        msgs.clear();
+    }
+}
+
+void ENetClient::stopThread()
+{
+    if (!thread_.joinable()) {
+        return;
+    }
+    running_ = false;
+    thread_.join();
+    // discard anything the thread didn't get to
+    Outbound out;
+    while (outbound_.pop(out)) {
+    }
+    staged_.clear();
+}
+
+void ENetClient::sampleStats(std::time_t now)
+{
+    if (!server_ || now - lastSample_ < STATS_INTERVAL) {
+        return;
+    }
+    monitor_.sample(SERVER_ID, server_, now);
+    lastSample_ = now;
+    // publish the sample
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_ = monitor_.stats();
+}
+
+PeerStats ENetClient::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
 }
@@ -1,14 +1,22 @@
 #include "enet/ENetServer.h"
 
 #include "Common.h"
+#include "enet/ENetChannel.h"
 #include "log/Log.h"
 #include "time/Time.h"
 
-const uint32_t MAX_CONNECTIONS = 64;
+#include <algorithm>
+
 const std::time_t TIMEOUT_MS = 5000;
-const uint8_t RELIABLE_CHANNEL = 0;
-const uint8_t UNRELIABLE_CHANNEL = 1;
-const uint8_t NUM_CHANNELS = 2;
+// socket buffer space to reserve per connection, so that a burst from every
+// client doesn't overflow the default kernel buffers
+const int32_t SOCKET_BUFFER_PER_CONNECTION = 4096;
+const int32_t MIN_SOCKET_BUFFER = 256 * 1024;
+// how long the network thread waits for incoming packets before checking the
+// outbound queue again
+const uint32_t SERVICE_TIMEOUT_MS = 1;
+// number of messages that can be waiting in each direction
+const size_t QUEUE_CAPACITY = 8192;
 
 std::string addressToString(const ENetAddress* address)
 {
@@ -19,14 +27,25 @@ std::string addressToString(const ENetAddress* address)
     return std::to_string(a) + "." + std::to_string(b) + "." + std::to_string(c) + "." + std::to_string(d) + ":" + std::to_string(address->port);
 }
 
-ENetServer::Shared ENetServer::alloc()
+ENetServer::Shared ENetServer::alloc(bool threaded, uint32_t idOffset)
 {
-    return std::make_shared<ENetServer>();
+    return std::make_shared<ENetServer>(threaded, idOffset);
 }
 
-ENetServer::ENetServer()
+ENetServer::ENetServer(bool threaded, uint32_t idOffset)
     : host_(nullptr)
+    , requests_(RequestTable::alloc())
+    , compressor_(PacketCompressor::alloc(Compression::NONE))
     , currentMsgId_(0)
+    , numQueued_(0)
+    , threaded_(threaded)
+    , idOffset_(idOffset)
+    , running_(false)
+    , numClients_(0)
+    , numSent_(0)
+    , inbound_(QUEUE_CAPACITY)
+    , outbound_(QUEUE_CAPACITY)
+    , lastSample_(0)
 {
     // initialize enet
     // TODO: prevent this from being called multiple times
@@ -44,8 +63,15 @@ ENetServer::~ENetServer()
     enet_deinitialize();
 }
 
-bool ENetServer::start(uint32_t port)
+bool ENetServer::start(uint32_t port, uint32_t maxConnections)
 {
+    if (maxConnections == 0 || maxConnections > MAX_PEER_ID + 1) {
+        LOG_ERROR("Connection limit must be between 1 and "
+            << (MAX_PEER_ID + 1)
+            << ", got "
+            << maxConnections);
+        return 1;
+    }
     // create address
     ENetAddress address;
     enet_address_set_host(&address, "localhost");
@@ -53,7 +79,7 @@ bool ENetServer::start(uint32_t port)
     // create host
     host_ = enet_host_create(
         &address, // the address to bind the server host to
-        MAX_CONNECTIONS, // allow up to N clients and/or outgoing connections
+        maxConnections, // allow up to N clients and/or outgoing connections
         NUM_CHANNELS, // allow up to N channels to be used
         0, // assume any amount of incoming bandwidth
         0); // assume any amount of outgoing bandwidth
@@ -63,6 +89,22 @@ bool ENetServer::start(uint32_t port)
         LOG_ERROR("An error occurred while trying to create an ENet server host");
         return 1;
     }
+    // size the kernel buffers for the number of connections
+    int32_t bufferSize = std::max(
+        MIN_SOCKET_BUFFER,
+        int32_t(maxConnections) * SOCKET_BUFFER_PER_CONNECTION);
+    enet_socket_set_option(host_->socket, ENET_SOCKOPT_RCVBUF, bufferSize);
+    enet_socket_set_option(host_->socket, ENET_SOCKOPT_SNDBUF, bufferSize);
+    // compress outgoing datagrams
+    compressor_->install(host_);
+    // ENet hands out peer ids in [0, maxConnections), so they index directly
+    // into the peer table
+    peers_ = std::vector<PeerEntry>(maxConnections);
+    if (threaded_) {
+        // hand the host over to the network thread
+        running_ = true;
+        thread_ = std::thread(&ENetServer::run, this);
+    }
     return 0;
 }
 
@@ -72,12 +114,30 @@ bool ENetServer::stop()
         // no clients to disconnect from
         return 0;
     }
+    if (thread_.joinable()) {
+        // take the host back from the network thread
+        running_ = false;
+        thread_.join();
+        // discard anything still waiting in the queues
+        Message::Shared msg;
+        while (inbound_.pop(msg)) {
+        }
+        Outbound out;
+        while (outbound_.pop(out)) {
+        }
+        for (auto& entry : peers_) {
+            entry.staged.clear();
+        }
+    }
     // attempt to gracefully disconnect all clients
     LOG_DEBUG("Disconnecting " << numClients() << " clients...");
-    for (auto iter : clients_) {
-        auto client = iter.second;
-        LOG_DEBUG("Disconnecting from client_" << client->incomingPeerID);
-        enet_peer_disconnect(client, 0);
+    uint32_t remaining = 0;
+    for (auto& entry : peers_) {
+        if (entry.peer) {
+            LOG_DEBUG("Disconnecting from client_" << entry.peer->incomingPeerID);
+            enet_peer_disconnect(entry.peer, 0);
+            remaining++;
+        }
     }
     // wait for the disconnections to be acknowledged
     auto timestamp = Time::timestamp();
@@ -93,13 +153,15 @@ bool ENetServer::stop()
                 enet_packet_destroy(event.packet);
             } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
                 // disconnect successful
+                // remove from remaining
+                if (removePeer(event.peer)) {
+                    remaining--;
+                }
                 LOG_DEBUG("Disconnection of client_"
                     << event.peer->incomingPeerID
                     << " succeeded, "
-                    << (clients_.size() - 1)
+                    << remaining
                     << " remaining");
-                // remove from remaining
-                clients_.erase(event.peer->incomingPeerID);
             } else if (event.type == ENET_EVENT_TYPE_CONNECT) {
                 // client connected
                 LOG_DEBUG("Connection accepted from client_"
@@ -108,7 +170,9 @@ bool ENetServer::stop()
                 // add and remove client
                 enet_peer_disconnect(event.peer, 0);
                 // add to remaining
-                clients_[event.peer->incomingPeerID] = event.peer;
+                if (addPeer(event.peer)) {
+                    remaining++;
+                }
             }
         } else if (res < 0) {
             // error occured
@@ -116,7 +180,7 @@ bool ENetServer::stop()
             break;
         } else {
             // no event, check if finished
-            if (clients_.empty()) {
+            if (remaining == 0) {
                 // all clients successfully disconnected
                 LOG_DEBUG("Disconnection from all clients successful");
                 success = true;
@@ -130,14 +194,21 @@ bool ENetServer::stop()
         }
     }
     // force disconnect the remaining clients
-    for (auto iter : clients_) {
-        auto id = iter.first;
-        auto client = iter.second;
-        LOG_DEBUG("Forcibly disconnecting client_" << id);
-        enet_peer_reset(client);
+    for (auto& entry : peers_) {
+        if (entry.peer) {
+            LOG_DEBUG("Forcibly disconnecting client_" << entry.peer->incomingPeerID);
+            enet_peer_reset(entry.peer);
+        }
     }
     // clear clients
-    clients_ = std::map<uint32_t, ENetPeer*>();
+    peers_ = std::vector<PeerEntry>();
+    numClients_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex_);
+        stats_.clear();
+    }
+    // fail any outstanding requests
+    requests_->clear();
     // destroy the host
     enet_host_destroy(host_);
     host_ = nullptr;
@@ -151,7 +222,9 @@ bool ENetServer::isRunning() const
 
 uint32_t ENetServer::numClients() const
 {
-    return host_->connectedPeers;
+    // NOTE: tracked separately from the host so that it can be read while the
+    // network thread owns the host
+    return numClients_;
 }
 
 void ENetServer::on(uint32_t id, RequestHandler handler)
@@ -159,35 +232,68 @@ void ENetServer::on(uint32_t id, RequestHandler handler)
     handlers_[id] = handler;
 }
 
-void ENetServer::handleRequest(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream) const
+void ENetServer::setCompression(Compression type)
 {
-    auto iter = handlers_.find(requestId);
+    if (isRunning()) {
+        LOG_WARN("Compression must be set before the server is started");
+        return;
+    }
+    compressor_ = PacketCompressor::alloc(type);
+}
+
+CompressionStats ENetServer::compressionStats() const
+{
+    return compressor_->stats();
+}
+
+void ENetServer::handleRequest(const Message::Shared& msg) const
+{
+    auto iter = handlers_.find(msg->requestId());
     if (iter != handlers_.end()) {
         auto handler = iter->second;
-        auto res = handler(id, stream);
-        sendResponse(id, requestId, res);
+        auto res = handler(msg->peerId(), msg->stream());
+        // respond with the id of the request message so the client can match
+        // it against its outstanding requests
+        sendResponse(msg->peerId(), msg->id(), res);
     }
 }
 
 ENetPeer* ENetServer::getClient(uint32_t id) const
 {
-    auto iter = clients_.find(id);
-    if (iter == clients_.end()) {
+    uint32_t index = id - idOffset_;
+    if (id < idOffset_ || index >= peers_.size() || !peers_[index].peer) {
         // no client to send to
         LOG_WARN("No connected client with id: " << id);
         return nullptr;
     }
-    return iter->second;
+    return peers_[index].peer;
 }
 
-void ENetServer::sendResponse(uint id, uint32_t requestId, StreamBuffer::Shared stream) const
+bool ENetServer::addPeer(ENetPeer* peer)
 {
-    auto client = getClient(id);
-    if (!client) {
-        // no client to send to
-        LOG_WARN("No connected client with id: " << id);
-        return;
+    uint32_t id = peer->incomingPeerID;
+    if (id >= peers_.size() || peers_[id].peer) {
+        return false;
+    }
+    peers_[id] = PeerEntry();
+    peers_[id].peer = peer;
+    numClients_++;
+    return true;
+}
+
+bool ENetServer::removePeer(ENetPeer* peer)
+{
+    uint32_t id = peer->incomingPeerID;
+    if (id >= peers_.size() || !peers_[id].peer) {
+        return false;
     }
+    peers_[id] = PeerEntry();
+    numClients_--;
+    return true;
+}
+
+void ENetServer::sendResponse(uint id, uint32_t requestId, StreamBuffer::Shared stream) const
+{
     auto msg = Message::alloc(
         ++currentMsgId_, // id
         requestId, // request id
@@ -197,6 +303,22 @@ void ENetServer::sendResponse(uint id, uint32_t requestId, StreamBuffer::Shared
 }
 
 void ENetServer::sendMessage(uint32_t id, DeliveryType type, Message::Shared msg) const
+{
+    if (threaded_) {
+        // frame the message on the calling thread, a stream shared by
+        // several messages must not be framed by two threads at once
+        size_t numBytes = 0;
+        msg->serialize(numBytes);
+        // the network thread writes the packet
+        enqueue(Outbound(id, false, type, msg));
+    } else {
+        writeMessage(id, type, msg);
+    }
+    // NOTE: the packet is queued and sent with everything else on `flush`
+    numQueued_++;
+}
+
+void ENetServer::writeMessage(uint32_t id, DeliveryType type, Message::Shared msg) const
 {
     auto client = getClient(id);
     if (!client) {
@@ -204,28 +326,16 @@ void ENetServer::sendMessage(uint32_t id, DeliveryType type, Message::Shared msg
         LOG_WARN("No connected client with id: " << id);
         return;
     }
-    uint32_t channel = 0;
+    uint8_t channel = 0;
     uint32_t flags = 0;
-    if (type == DeliveryType::RELIABLE) {
-        channel = RELIABLE_CHANNEL;
-        flags = ENET_PACKET_FLAG_RELIABLE;
-    } else {
-        channel = UNRELIABLE_CHANNEL;
-        flags = ENET_PACKET_FLAG_UNSEQUENCED;
-    }
+    getChannel(type, channel, flags);
 
-    // get bytes
-    auto data = msg->serialize();
-    // create the packet
-    ENetPacket* p = enet_packet_create(
-        &data[0],
-        data.size(),
-        flags);
+    // create the packet, this references the message rather than copying it
+    ENetPacket* p = createPacket(msg, flags);
 
     // send the packet to the peer
+    peers_[client->incomingPeerID].monitor.sent(p->dataLength);
     enet_peer_send(client, channel, p);
-    // flush / send the packet queue
-    enet_host_flush(host_);
 }
 
 void ENetServer::send(uint32_t id, DeliveryType type, StreamBuffer::Shared stream) const
@@ -243,30 +353,36 @@ void ENetServer::broadcastMessage(DeliveryType type, Message::Shared msg) const
         // no clients to broadcast to
         return;
     }
-
-    uint32_t channel = 0;
-    uint32_t flags = 0;
-    if (type == DeliveryType::RELIABLE) {
-        channel = RELIABLE_CHANNEL;
-        flags = ENET_PACKET_FLAG_RELIABLE;
+    if (threaded_) {
+        // frame the message on the calling thread, a stream shared by
+        // several messages must not be framed by two threads at once
+        size_t numBytes = 0;
+        msg->serialize(numBytes);
+        // the network thread writes the packet
+        enqueue(Outbound(0, true, type, msg));
     } else {
-        channel = UNRELIABLE_CHANNEL;
-        flags = ENET_PACKET_FLAG_UNSEQUENCED;
+        writeBroadcast(type, msg);
     }
+    // NOTE: the packet is queued and sent with everything else on `flush`
+    numQueued_++;
+}
 
-    // get bytes
-    auto data = msg->serialize();
+void ENetServer::writeBroadcast(DeliveryType type, Message::Shared msg) const
+{
+    uint8_t channel = 0;
+    uint32_t flags = 0;
+    getChannel(type, channel, flags);
 
-    // create the packet
-    ENetPacket* p = enet_packet_create(
-        &data[0],
-        data.size(),
-        flags);
+    // create the packet, this references the message rather than copying it
+    ENetPacket* p = createPacket(msg, flags);
 
+    for (auto& entry : peers_) {
+        if (entry.peer) {
+            entry.monitor.sent(p->dataLength);
+        }
+    }
     // send the packet to the peer
     enet_host_broadcast(host_, channel, p);
-    // flush / send the packet queue
-    enet_host_flush(host_);
 }
 
 void ENetServer::broadcast(DeliveryType type, StreamBuffer::Shared stream) const
@@ -278,13 +394,105 @@ void ENetServer::broadcast(DeliveryType type, StreamBuffer::Shared stream) const
     broadcastMessage(type, msg);
 }
 
+uint32_t ENetServer::sendRequest(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream) const
+{
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        requestId, // request id
+        MessageType::DATA_REQUEST,
+        stream);
+    sendMessage(id, DeliveryType::RELIABLE, msg);
+    return msg->id();
+}
+
+void ENetServer::request(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
+{
+    // NOTE: if the client is not connected the request is cancelled when its
+    // disconnect is dispatched, or times out
+    auto msgId = sendRequest(id, requestId, stream);
+    requests_->add(msgId, id, handler, timeout);
+}
+
+uint32_t ENetServer::flush()
+{
+    if (!isRunning()) {
+        return 0;
+    }
+    if (threaded_) {
+        // ask the network thread to flush, the datagrams it has sent since
+        // the last call are returned instead
+        enqueue(Outbound());
+        numQueued_ = 0;
+        return numSent_.exchange(0);
+    }
+    // send all queued packets, ENet coalesces the packets queued for each
+    // peer into as few datagrams as the MTU allows
+    auto before = host_->totalSentPackets;
+    enet_host_flush(host_);
+    auto sent = host_->totalSentPackets - before;
+    numQueued_ = 0;
+    return sent;
+}
+
+uint32_t ENetServer::numQueued() const
+{
+    return numQueued_;
+}
+
 std::vector<Message::Shared> ENetServer::poll()
 {
     std::vector<Message::Shared> msgs;
+    if (threaded_) {
+        // take everything the network thread has received
+        Message::Shared msg;
+        while (inbound_.pop(msg)) {
+            msgs.push_back(msg);
+        }
+    } else if (isRunning()) {
+        service(msgs, 0);
+        sampleStats(Time::timestamp());
+    }
+    return dispatch(msgs);
+}
+
+std::vector<Message::Shared> ENetServer::dispatch(const std::vector<Message::Shared>& received)
+{
+    std::vector<Message::Shared> msgs;
+    for (auto msg : received) {
+        switch (msg->type()) {
+        case MessageType::DATA_RESPONSE:
+            // complete outstanding requests
+            if (!requests_->resolve(msg)) {
+                LOG_DEBUG("Discarding response to unknown request "
+                    << msg->requestId());
+            }
+            break;
+        case MessageType::DATA_REQUEST:
+            msgs.push_back(msg);
+            handleRequest(msg);
+            break;
+        case MessageType::DISCONNECT:
+            msgs.push_back(msg);
+            // fail any requests the client can no longer respond to
+            requests_->cancel(msg->peerId());
+            break;
+        default:
+            msgs.push_back(msg);
+            break;
+        }
+    }
+    // fail any requests that have timed out
+    requests_->expire(Time::timestamp());
+    return msgs;
+}
+
+void ENetServer::service(std::vector<Message::Shared>& msgs, uint32_t timeout)
+{
     ENetEvent event;
     while (true) {
-        // poll with a zero timeout
-        int32_t res = enet_host_service(host_, &event, 0);
+        // only the first call waits, the rest drain what has already arrived
+        int32_t res = enet_host_service(host_, &event, timeout);
+        timeout = 0;
         if (res > 0) {
             // event occured
             if (event.type == ENET_EVENT_TYPE_RECEIVE) {
@@ -296,27 +504,45 @@ std::vector<Message::Shared> ENetServer::poll()
                 //     << "` was received from client_"
                 //     << event.peer->incomingPeerID);
 
+                // view the packet payload rather than copying it, the
+                // packet is destroyed once the last message referencing it is
+                auto packet = std::shared_ptr<ENetPacket>(
+                    event.packet,
+                    enet_packet_destroy);
                 auto stream = StreamBuffer::alloc(
-                    event.packet->data,
-                    event.packet->dataLength);
+                    packet->data,
+                    packet->dataLength,
+                    packet);
 
                 // deserialize message
-                auto msg = Message::alloc(event.peer->incomingPeerID);
+                auto msg = Message::alloc(idOffset_ + event.peer->incomingPeerID);
                 msg->deserialize(stream);
-                msgs.push_back(msg);
 
-                // handle requests
-                if (msg->type() == MessageType::DATA_REQUEST) {
-                    handleRequest(
-                        event.peer->incomingPeerID,
-                        msg->requestId(),
-                        msg->stream());
+                auto& entry = peers_[event.peer->incomingPeerID];
+                entry.monitor.received(packet->dataLength);
+
+                // drop stale or out-of-order sequenced messages
+                if (event.channelID == SEQUENCED_CHANNEL) {
+                    if (entry.hasSequence && !isNewer(msg->id(), entry.sequence)) {
+                        continue;
+                    }
+                    entry.sequence = msg->id();
+                    entry.hasSequence = true;
                 }
 
-                // destroy packet payload
-                enet_packet_destroy(event.packet);
+                msgs.push_back(msg);
 
             } else if (event.type == ENET_EVENT_TYPE_CONNECT) {
+                // the client sends the codecs it can decompress, the
+                // compressor is shared by the whole host so clients that
+                // can't read its output are turned away
+                if (!PacketCompressor::supports(event.data, compressor_->type())) {
+                    LOG_WARN("Client from "
+                        << addressToString(&event.peer->address)
+                        << " does not support the server compression, disconnect");
+                    enet_peer_disconnect_now(event.peer, 0);
+                    continue;
+                }
                 // client connected
                 LOG_DEBUG("Client has connected from "
                     << addressToString(&event.peer->address)
@@ -325,10 +551,10 @@ std::vector<Message::Shared> ENetServer::poll()
                     << " connected clients");
                 // add msg
                 auto msg = Message::alloc(
-                    event.peer->incomingPeerID,
+                    idOffset_ + event.peer->incomingPeerID,
                     MessageType::CONNECT);
                 msgs.push_back(msg);
-                clients_[event.peer->incomingPeerID] = event.peer;
+                addPeer(event.peer);
 
             } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
                 // client disconnected
@@ -339,10 +565,10 @@ std::vector<Message::Shared> ENetServer::poll()
                     << " clients remaining");
                 // add msg
                 auto msg = Message::alloc(
-                    event.peer->incomingPeerID,
+                    idOffset_ + event.peer->incomingPeerID,
                     MessageType::DISCONNECT);
                 msgs.push_back(msg);
-                clients_.erase(event.peer->incomingPeerID);
+                removePeer(event.peer);
             }
         } else if (res < 0) {
             // error occured
@@ -353,5 +579,107 @@ std::vector<Message::Shared> ENetServer::poll()
             break;
         }
     }
-    return msgs;
+}
+
+void ENetServer::enqueue(const Outbound& out) const
+{
+    // NOTE: if the network thread falls behind, wait for it rather than
+    // dropping reliable messages
+    while (!outbound_.push(out)) {
+        if (!running_) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void ENetServer::stage(const Outbound& out)
+{
+    if (out.broadcast) {
+        // staged for each peer so it stays in order with their own messages
+        for (auto& entry : peers_) {
+            if (entry.peer) {
+                entry.staged.push_back(out);
+            }
+        }
+        return;
+    }
+    auto client = getClient(out.id);
+    if (client) {
+        peers_[client->incomingPeerID].staged.push_back(out);
+    }
+}
+
+void ENetServer::writeStaged()
+{
+    for (auto& entry : peers_) {
+        if (!entry.peer) {
+            continue;
+        }
+        for (const auto& out : entry.staged) {
+            writeMessage(idOffset_ + entry.peer->incomingPeerID, out.type, out.msg);
+        }
+        entry.staged.clear();
+    }
+}
+
+void ENetServer::run()
+{
+    std::vector<Message::Shared> msgs;
+    while (running_) {
+        auto before = host_->totalSentPackets;
+        // hold everything queued by the simulation thread until it flushes,
+        // otherwise servicing the host would send a tick's messages as they
+        // arrive rather than together
+        Outbound out;
+        while (outbound_.pop(out)) {
+            if (!out.msg) {
+                writeStaged();
+                enet_host_flush(host_);
+            } else {
+                stage(out);
+            }
+        }
+        // wait briefly for incoming packets
+        service(msgs, SERVICE_TIMEOUT_MS);
+        numSent_ += host_->totalSentPackets - before;
+        sampleStats(Time::timestamp());
+        // hand the received messages to the simulation thread
+        for (auto msg : msgs) {
+            while (!inbound_.push(msg)) {
+                if (!running_) {
+                    return;
+                }
+                std::this_thread::yield();
+            }
+        }
+        msgs.clear();
+    }
+}
+
+void ENetServer::sampleStats(std::time_t now)
+{
+    if (now - lastSample_ < STATS_INTERVAL) {
+        return;
+    }
+    std::vector<PeerStats> stats;
+    for (auto& entry : peers_) {
+        if (entry.peer) {
+            entry.monitor.sample(
+                idOffset_ + entry.peer->incomingPeerID,
+                entry.peer,
+                now);
+            stats.push_back(entry.monitor.stats());
+        }
+    }
+    lastSample_ = now;
+    // publish the sample
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_.swap(stats);
+}
+
+std::vector<PeerStats> ENetServer::stats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
 }
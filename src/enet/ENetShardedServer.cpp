@@ -0,0 +1,171 @@
+#include "enet/ENetShardedServer.h"
+
+#include "log/Log.h"
+
+ENetShardedServer::Shared ENetShardedServer::alloc(uint32_t numShards)
+{
+    return std::make_shared<ENetShardedServer>(numShards);
+}
+
+ENetShardedServer::ENetShardedServer(uint32_t numShards)
+{
+    for (uint32_t i = 0; i < numShards; i++) {
+        shards_.push_back(ENetServer::alloc(true, i * SHARD_ID_STRIDE));
+    }
+}
+
+bool ENetShardedServer::start(uint32_t port, uint32_t maxConnections)
+{
+    // NOTE: ENet binds its socket while creating the host, so there is no
+    // opportunity to set SO_REUSEPORT. Each shard gets its own port instead.
+    uint32_t numShards = shards_.size();
+    uint32_t perShard = (maxConnections + numShards - 1) / numShards;
+    for (uint32_t i = 0; i < numShards; i++) {
+        if (shards_[i]->start(port + i, perShard)) {
+            LOG_ERROR("Failed to start shard " << i << " on port " << (port + i));
+            stop();
+            return 1;
+        }
+    }
+    LOG_INFO("Started "
+        << numShards
+        << " shards on ports "
+        << port
+        << "-"
+        << (port + numShards - 1));
+    return 0;
+}
+
+bool ENetShardedServer::stop()
+{
+    bool err = false;
+    for (auto shard : shards_) {
+        if (shard->stop()) {
+            err = true;
+        }
+    }
+    return err;
+}
+
+bool ENetShardedServer::isRunning() const
+{
+    for (auto shard : shards_) {
+        if (!shard->isRunning()) {
+            return false;
+        }
+    }
+    return !shards_.empty();
+}
+
+uint32_t ENetShardedServer::numClients() const
+{
+    uint32_t count = 0;
+    for (auto shard : shards_) {
+        count += shard->numClients();
+    }
+    return count;
+}
+
+ENetServer::Shared ENetShardedServer::shard(uint32_t id) const
+{
+    uint32_t index = id / SHARD_ID_STRIDE;
+    if (index >= shards_.size()) {
+        LOG_WARN("No connected client with id: " << id);
+        return nullptr;
+    }
+    return shards_[index];
+}
+
+void ENetShardedServer::send(uint32_t id, DeliveryType type, StreamBuffer::Shared stream) const
+{
+    auto server = shard(id);
+    if (server) {
+        server->send(id, type, stream);
+    }
+}
+
+void ENetShardedServer::broadcast(DeliveryType type, StreamBuffer::Shared stream) const
+{
+    for (auto shard : shards_) {
+        shard->broadcast(type, stream);
+    }
+}
+
+uint32_t ENetShardedServer::flush()
+{
+    uint32_t sent = 0;
+    for (auto shard : shards_) {
+        sent += shard->flush();
+    }
+    return sent;
+}
+
+uint32_t ENetShardedServer::numQueued() const
+{
+    uint32_t count = 0;
+    for (auto shard : shards_) {
+        count += shard->numQueued();
+    }
+    return count;
+}
+
+void ENetShardedServer::request(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
+{
+    auto server = shard(id);
+    if (!server) {
+        // fail immediately, there is no client to respond
+        if (handler) {
+            handler(nullptr);
+        }
+        return;
+    }
+    server->request(id, requestId, stream, handler, timeout);
+}
+
+std::vector<Message::Shared> ENetShardedServer::poll()
+{
+    std::vector<Message::Shared> msgs;
+    for (auto shard : shards_) {
+        auto received = shard->poll();
+        msgs.insert(msgs.end(), received.begin(), received.end());
+    }
+    return msgs;
+}
+
+void ENetShardedServer::on(uint32_t id, RequestHandler handler)
+{
+    for (auto shard : shards_) {
+        shard->on(id, handler);
+    }
+}
+
+void ENetShardedServer::setCompression(Compression type)
+{
+    for (auto shard : shards_) {
+        shard->setCompression(type);
+    }
+}
+
+CompressionStats ENetShardedServer::compressionStats() const
+{
+    CompressionStats total;
+    for (auto shard : shards_) {
+        auto stats = shard->compressionStats();
+        total.datagrams += stats.datagrams;
+        total.bytesIn += stats.bytesIn;
+        total.bytesOut += stats.bytesOut;
+        total.compressTime += stats.compressTime;
+        total.decompressTime += stats.decompressTime;
+    }
+    return total;
+}
+
+std::vector<PeerStats> ENetShardedServer::stats() const
+{
+    std::vector<PeerStats> stats;
+    for (auto shard : shards_) {
+        auto shardStats = shard->stats();
+        stats.insert(stats.end(), shardStats.begin(), shardStats.end());
+    }
+    return stats;
+}
@@ -0,0 +1,179 @@
+#include "enet/PacketCompressor.h"
+
+#include "log/Log.h"
+#include "serial/AdaptiveCoder.h"
+#include "time/Time.h"
+
+#include <algorithm>
+#include <cstring>
+
+PacketCompressor::Shared PacketCompressor::alloc(Compression type)
+{
+    return std::make_shared<PacketCompressor>(type);
+}
+
+PacketCompressor::PacketCompressor(Compression type)
+    : type_(type)
+    , rangeCoder_(enet_range_coder_create())
+    , datagrams_(0)
+    , bytesIn_(0)
+    , bytesOut_(0)
+    , compressTime_(0)
+    , decompressTime_(0)
+{
+    if (rangeCoder_ == nullptr) {
+        LOG_ERROR("An error occurred while creating the ENet range coder");
+    }
+}
+
+PacketCompressor::~PacketCompressor()
+{
+    if (rangeCoder_) {
+        enet_range_coder_destroy(rangeCoder_);
+    }
+}
+
+void PacketCompressor::install(ENetHost* host)
+{
+    // NOTE: always installed, even when not compressing, so that compressed
+    // datagrams from the other end can still be read
+    ENetCompressor compressor;
+    compressor.context = this;
+    compressor.compress = &PacketCompressor::compress;
+    compressor.decompress = &PacketCompressor::decompress;
+    // the compressor is owned by the caller rather than the host
+    compressor.destroy = nullptr;
+    enet_host_compress(host, &compressor);
+}
+
+Compression PacketCompressor::type() const
+{
+    return type_;
+}
+
+CompressionStats PacketCompressor::stats() const
+{
+    CompressionStats stats;
+    stats.datagrams = datagrams_;
+    stats.bytesIn = bytesIn_;
+    stats.bytesOut = bytesOut_;
+    stats.compressTime = compressTime_;
+    stats.decompressTime = decompressTime_;
+    return stats;
+}
+
+uint32_t PacketCompressor::supported()
+{
+    return (1 << uint32_t(Compression::RANGE_CODER)) | (1 << uint32_t(Compression::ADAPTIVE));
+}
+
+bool PacketCompressor::supports(uint32_t mask, Compression type)
+{
+    return type == Compression::NONE || (mask & (1 << uint32_t(type)));
+}
+
+size_t ENET_CALLBACK PacketCompressor::compress(
+    void* context,
+    const ENetBuffer* inBuffers,
+    size_t inBufferCount,
+    size_t inLimit,
+    enet_uint8* outData,
+    size_t outLimit)
+{
+    auto compressor = static_cast<PacketCompressor*>(context);
+    auto timestamp = Time::timestamp();
+    size_t size = compressor->compressDatagram(inBuffers, inBufferCount, inLimit, outData, outLimit);
+    compressor->compressTime_ += Time::timestamp() - timestamp;
+    compressor->datagrams_++;
+    compressor->bytesIn_ += inLimit;
+    // ENet sends the datagram uncompressed if nothing is returned
+    compressor->bytesOut_ += (size > 0) ? size : inLimit;
+    return size;
+}
+
+size_t ENET_CALLBACK PacketCompressor::decompress(
+    void* context,
+    const enet_uint8* inData,
+    size_t inLimit,
+    enet_uint8* outData,
+    size_t outLimit)
+{
+    auto compressor = static_cast<PacketCompressor*>(context);
+    auto timestamp = Time::timestamp();
+    size_t size = compressor->decompressDatagram(inData, inLimit, outData, outLimit);
+    compressor->decompressTime_ += Time::timestamp() - timestamp;
+    return size;
+}
+
+size_t PacketCompressor::compressDatagram(
+    const ENetBuffer* inBuffers,
+    size_t inBufferCount,
+    size_t inLimit,
+    uint8_t* outData,
+    size_t outLimit)
+{
+    if (outLimit < 2) {
+        return 0;
+    }
+    size_t size = 0;
+    switch (type_) {
+    case Compression::RANGE_CODER:
+        if (!rangeCoder_) {
+            return 0;
+        }
+        size = enet_range_coder_compress(
+            rangeCoder_,
+            inBuffers,
+            inBufferCount,
+            inLimit,
+            outData + 1,
+            outLimit - 1);
+        break;
+    case Compression::ADAPTIVE:
+        // the adaptive coder works on contiguous bytes
+        scratch_.resize(inLimit);
+        for (size_t i = 0, offset = 0; i < inBufferCount && offset < inLimit; i++) {
+            size_t length = std::min(inBuffers[i].dataLength, inLimit - offset);
+            std::memcpy(&scratch_[offset], inBuffers[i].data, length);
+            offset += length;
+        }
+        size = adaptiveCompress(scratch_.data(), inLimit, outData + 1, outLimit - 1);
+        break;
+    default:
+        return 0;
+    }
+    if (size == 0 || size + 1 >= inLimit) {
+        // not worth it, send uncompressed
+        return 0;
+    }
+    outData[0] = uint8_t(type_);
+    return size + 1;
+}
+
+size_t PacketCompressor::decompressDatagram(
+    const uint8_t* inData,
+    size_t inLimit,
+    uint8_t* outData,
+    size_t outLimit)
+{
+    if (inLimit < 1) {
+        return 0;
+    }
+    // NOTE: a return of 0 makes ENet drop the datagram
+    switch (Compression(inData[0])) {
+    case Compression::RANGE_CODER:
+        if (!rangeCoder_) {
+            return 0;
+        }
+        return enet_range_coder_decompress(
+            rangeCoder_,
+            inData + 1,
+            inLimit - 1,
+            outData,
+            outLimit);
+    case Compression::ADAPTIVE:
+        return adaptiveDecompress(inData + 1, inLimit - 1, outData, outLimit);
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,46 @@
+#include "enet/PeerMonitor.h"
+
+PeerMonitor::PeerMonitor()
+    : lastSample_(0)
+    , packetsLost_(0)
+{
+}
+
+void PeerMonitor::sent(size_t bytes)
+{
+    stats_.messagesSent++;
+    stats_.bytesSent += bytes;
+}
+
+void PeerMonitor::received(size_t bytes)
+{
+    stats_.messagesReceived++;
+    stats_.bytesReceived += bytes;
+}
+
+void PeerMonitor::sample(uint32_t id, const ENetPeer* peer, std::time_t now)
+{
+    stats_.id = id;
+    stats_.roundTripTime = peer->roundTripTime;
+    stats_.roundTripTimeVariance = peer->roundTripTimeVariance;
+    stats_.packetLoss = float32_t(peer->packetLoss) / ENET_PEER_PACKET_LOSS_SCALE;
+    stats_.reliableInTransit = peer->reliableDataInTransit;
+    // NOTE: ENet resets its lost packet count at the start of each packet
+    // loss epoch, which is longer than the sample interval
+    if (peer->packetsLost >= packetsLost_) {
+        stats_.retransmits += peer->packetsLost - packetsLost_;
+    } else {
+        stats_.retransmits += peer->packetsLost;
+    }
+    packetsLost_ = peer->packetsLost;
+    if (lastSample_ > 0) {
+        updateRates(stats_, last_, now - lastSample_);
+    }
+    last_ = stats_;
+    lastSample_ = now;
+}
+
+const PeerStats& PeerMonitor::stats() const
+{
+    return stats_;
+}
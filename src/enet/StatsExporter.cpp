@@ -0,0 +1,132 @@
+#include "enet/StatsExporter.h"
+
+#include "log/Log.h"
+
+#include "json.hpp"
+
+StatsExporter::Shared StatsExporter::alloc()
+{
+    return std::make_shared<StatsExporter>();
+}
+
+StatsExporter::StatsExporter()
+    : socket_(ENET_SOCKET_NULL)
+{
+}
+
+StatsExporter::~StatsExporter()
+{
+    close();
+}
+
+bool StatsExporter::open(const std::string& target)
+{
+    close();
+    if (target.compare(0, 5, "file:") == 0) {
+        auto path = target.substr(5);
+        // append so that restarts don't lose earlier samples
+        file_.open(path, std::ios::out | std::ios::app);
+        if (!file_.is_open()) {
+            LOG_ERROR("Unable to open stats file `" << path << "`");
+            return 1;
+        }
+        return 0;
+    }
+    if (target.compare(0, 4, "udp:") == 0) {
+        auto address = target.substr(4);
+        auto colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            LOG_ERROR("Missing port in stats address `" << address << "`");
+            return 1;
+        }
+        auto host = address.substr(0, colon);
+        if (enet_address_set_host(&address_, host.c_str()) != 0) {
+            LOG_ERROR("Unable to resolve stats host `" << host << "`");
+            return 1;
+        }
+        address_.port = std::stoul(address.substr(colon + 1));
+        socket_ = enet_socket_create(ENET_SOCKET_TYPE_DATAGRAM);
+        if (socket_ == ENET_SOCKET_NULL) {
+            LOG_ERROR("Unable to create stats socket");
+            return 1;
+        }
+        return 0;
+    }
+    LOG_ERROR("Unknown stats target `"
+        << target
+        << "`, expected `file:PATH` or `udp:HOST:PORT`");
+    return 1;
+}
+
+void StatsExporter::close()
+{
+    if (file_.is_open()) {
+        file_.close();
+    }
+    if (socket_ != ENET_SOCKET_NULL) {
+        enet_socket_destroy(socket_);
+        socket_ = ENET_SOCKET_NULL;
+    }
+}
+
+bool StatsExporter::isOpen() const
+{
+    return file_.is_open() || socket_ != ENET_SOCKET_NULL;
+}
+
+void StatsExporter::write(std::time_t timestamp, const std::vector<PeerStats>& stats)
+{
+    for (const auto& peer : stats) {
+        write(timestamp, peer);
+    }
+}
+
+void StatsExporter::write(std::time_t timestamp, const PeerStats& stats)
+{
+    nlohmann::json json;
+    json["type"] = "peer";
+    json["timestamp"] = timestamp;
+    json["id"] = stats.id;
+    json["rtt"] = stats.roundTripTime;
+    json["rttVariance"] = stats.roundTripTimeVariance;
+    json["packetLoss"] = stats.packetLoss;
+    json["reliableInTransit"] = stats.reliableInTransit;
+    json["retransmits"] = stats.retransmits;
+    json["messagesSent"] = stats.messagesSent;
+    json["messagesReceived"] = stats.messagesReceived;
+    json["bytesSent"] = stats.bytesSent;
+    json["bytesReceived"] = stats.bytesReceived;
+    json["messagesSentPerSec"] = stats.messagesSentPerSec;
+    json["messagesReceivedPerSec"] = stats.messagesReceivedPerSec;
+    json["bytesSentPerSec"] = stats.bytesSentPerSec;
+    json["bytesReceivedPerSec"] = stats.bytesReceivedPerSec;
+    writeLine(json.dump());
+}
+
+void StatsExporter::write(std::time_t timestamp, const CompressionStats& stats)
+{
+    nlohmann::json json;
+    json["type"] = "compression";
+    json["timestamp"] = timestamp;
+    json["datagrams"] = stats.datagrams;
+    json["bytesIn"] = stats.bytesIn;
+    json["bytesOut"] = stats.bytesOut;
+    json["compressTime"] = stats.compressTime;
+    json["decompressTime"] = stats.decompressTime;
+    writeLine(json.dump());
+}
+
+void StatsExporter::writeLine(const std::string& line)
+{
+    if (file_.is_open()) {
+        file_ << line << std::endl;
+    }
+    if (socket_ != ENET_SOCKET_NULL) {
+        ENetBuffer buffer;
+        buffer.data = const_cast<char*>(line.data());
+        buffer.dataLength = line.size();
+        if (enet_socket_send(socket_, &address_, &buffer, 1) < 0) {
+            LOG_WARN("Unable to send stats to collector");
+        }
+    }
+}
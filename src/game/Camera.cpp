@@ -108,7 +108,7 @@ void Camera::updateZoom(std::time_t dt)
 
 void Camera::updateTarget(std::time_t dt)
 {
-    auto diff = target_->transform()->translation() - targetPosition_;
+    auto diff = target_->translation() - targetPosition_;
     auto fdt = Time::toSeconds(dt) * FOLLOW_EASING_FACTOR;
     auto dist = std::min(glm::length(diff), float32_t(fdt));
     if (dist < M_EPSILON) {
@@ -120,14 +120,14 @@ void Camera::updateTarget(std::time_t dt)
     targetPosition_ += delta;
 }
 
-void Camera::follow(Player::Shared target)
+void Camera::follow(Transform::Shared target)
 {
-    if (target_ && target_->id() == target->id()) {
+    if (target_) {
         target_ = target;
         return;
     }
     target_ = target;
-    targetPosition_ = target_->transform()->translation();
+    targetPosition_ = target_->translation();
 }
 
 void Camera::setPerspective(float32_t fov, float32_t aspect, float32_t near, float32_t far)
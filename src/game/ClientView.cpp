@@ -0,0 +1,313 @@
+#include "game/ClientView.h"
+
+#include "game/Game.h"
+#include "game/PayloadType.h"
+#include "time/Time.h"
+
+#include <algorithm>
+#include <functional>
+
+// snapshot ids start at 1, 0 is reserved for "no baseline"
+const uint32_t NO_SNAPSHOT = 0;
+
+// no player update is smaller than its id and field mask
+const int64_t MIN_PLAYER_SIZE = sizeof(uint32_t) + sizeof(uint8_t);
+
+// priority carried over for a player, 0 if it has none
+static float32_t carriedPriority(const std::vector<std::pair<uint32_t, float32_t> >& priorities, uint32_t id)
+{
+    auto iter = std::lower_bound(
+        priorities.begin(),
+        priorities.end(),
+        std::make_pair(id, 0.0f),
+        [](const std::pair<uint32_t, float32_t>& a, const std::pair<uint32_t, float32_t>& b) {
+            return a.first < b.first;
+        });
+    if (iter == priorities.end() || iter->first != id) {
+        return 0.0f;
+    }
+    return iter->second;
+}
+
+ClientView::Shared ClientView::alloc(uint32_t id, const Interest& interest)
+{
+    return std::make_shared<ClientView>(id, interest);
+}
+
+ClientView::ClientView(uint32_t id, const Interest& interest)
+    : id_(id)
+    , interest_(interest)
+    , sequence_(NO_SNAPSHOT)
+    , acked_(NO_SNAPSHOT)
+    , sent_(SnapshotHistory::alloc(Game::SNAPSHOT_HISTORY))
+    , inputAck_(0)
+    , viewTime_(0)
+    , budget_(Game::SNAPSHOT_BUDGET)
+    , minRoundTrip_(0)
+    , requestedRate_(Game::SEND_RATE)
+    , sendRate_(Game::SEND_RATE)
+    , nextSend_(0)
+{
+}
+
+uint32_t ClientView::id() const
+{
+    return id_;
+}
+
+bool ClientView::acceptInput(uint32_t sequence)
+{
+    // inputs are resent until acknowledged, so most arrive more than once
+    if (inputAck_ != 0 && !isNewer(sequence, inputAck_)) {
+        return false;
+    }
+    inputAck_ = sequence;
+    return true;
+}
+
+uint32_t ClientView::inputAck() const
+{
+    return inputAck_;
+}
+
+void ClientView::setViewTime(std::time_t viewTime)
+{
+    viewTime_ = viewTime;
+}
+
+std::time_t ClientView::viewTime() const
+{
+    return viewTime_;
+}
+
+void ClientView::ack(uint32_t id)
+{
+    // ignore stale or unknown acks
+    if (!sent_->find(id)) {
+        return;
+    }
+    if (acked_ == NO_SNAPSHOT || isNewer(id, acked_)) {
+        acked_ = id;
+    }
+}
+
+Snapshot::Shared ClientView::baseline() const
+{
+    if (acked_ == NO_SNAPSHOT) {
+        return nullptr;
+    }
+    // NOTE: if the acked snapshot has fallen out of the history the client
+    // gets a full snapshot, this bounds the delta size after heavy loss
+    return sent_->find(acked_);
+}
+
+void ClientView::setBudget(uint32_t budget)
+{
+    budget_ = budget;
+}
+
+uint32_t ClientView::budget() const
+{
+    return budget_;
+}
+
+void ClientView::adaptBudget(const PeerStats& stats)
+{
+    if (stats.roundTripTime == 0) {
+        // nothing measured yet
+        return;
+    }
+    // a round trip above the lowest one is time spent queued on the way
+    if (minRoundTrip_ == 0 || stats.roundTripTime < minRoundTrip_) {
+        minRoundTrip_ = stats.roundTripTime;
+    }
+    if (stats.packetLoss > Game::MAX_PACKET_LOSS
+        || stats.roundTripTime - minRoundTrip_ > Game::MAX_QUEUEING_DELAY) {
+        // send less of the world rather than have the link drop it
+        budget_ = std::max(Game::MIN_SNAPSHOT_BUDGET, budget_ / 2);
+    } else if (budget_ < Game::SNAPSHOT_BUDGET) {
+        budget_ = std::min(Game::SNAPSHOT_BUDGET, budget_ + Game::SNAPSHOT_BUDGET_STEP);
+    }
+}
+
+void ClientView::setSendRate(uint32_t rate)
+{
+    requestedRate_ = std::max(1u, rate);
+    sendRate_ = requestedRate_;
+}
+
+uint32_t ClientView::sendRate() const
+{
+    return sendRate_;
+}
+
+bool ClientView::due(std::time_t now)
+{
+    if (now < nextSend_) {
+        return false;
+    }
+    // sends land on steps, carry the remainder over so the rate holds on
+    // average, unless it has fallen behind by more than a send
+    std::time_t interval = Time::fromRate(sendRate_);
+    if (nextSend_ == 0 || now - nextSend_ > interval) {
+        nextSend_ = now + interval;
+    } else {
+        nextSend_ += interval;
+    }
+    return true;
+}
+
+void ClientView::adaptSendRate()
+{
+    auto latest = sent_->latest();
+    if (!latest || acked_ == NO_SNAPSHOT) {
+        // nothing acked yet to judge by
+        return;
+    }
+    // how far the newest snapshot acked is behind the newest sent, an ack
+    // that has fallen out of the history is as far behind as it gets
+    auto base = baseline();
+    std::time_t interval = Time::fromRate(sendRate_);
+    std::time_t lag = base ? latest->timestamp() - base->timestamp() : Game::MAX_ACK_LAG + interval;
+    if (lag - interval >= Game::MAX_ACK_LAG) {
+        // fewer, larger deltas are cheaper than ones it can't acknowledge
+        sendRate_ = std::max(std::min(Game::MIN_SEND_RATE, requestedRate_), sendRate_ / 2);
+    } else if (sendRate_ < requestedRate_) {
+        sendRate_++;
+    }
+}
+
+float32_t ClientView::weight(const Snapshot::Shared& snapshot, uint32_t index, const Snapshot::Shared& previous, int32_t sent, const glm::vec3& center) const
+{
+    if (sent < 0) {
+        // new to the client
+        return 1.0f;
+    }
+    uint8_t mask = snapshot->diff(index, previous, sent);
+    if (!mask) {
+        // the client is up to date
+        return 0.0f;
+    }
+    // far away players accumulate priority slower
+    const auto& translation = snapshot->translations()[index];
+    auto diff = translation - center;
+    auto w = 1.0f;
+    if (glm::dot(diff, diff) > interest_.nearRadius * interest_.nearRadius) {
+        w /= interest_.farInterval;
+    }
+    // players that have moved further since they were last sent catch up
+    // faster
+    auto moved = glm::length(translation - previous->translations()[sent]);
+    w *= 1.0f + moved / Game::PRIORITY_MOVE_DISTANCE;
+    if (mask & SnapshotField::STATE) {
+        // state changes are sent straight away
+        w = std::max(w, 1.0f);
+    }
+    return w;
+}
+
+Snapshot::Shared ClientView::relevant(const Snapshot::Shared& snapshot, const SpatialHash::Shared& index)
+{
+    // the client's snapshots are numbered on their own, so the ids it is
+    // sent are consecutive whatever its rate
+    if (++sequence_ == NO_SNAPSHOT) {
+        sequence_++;
+    }
+    auto filtered = Snapshot::alloc(sequence_, snapshot->timestamp());
+
+    int32_t self = snapshot->find(id_);
+    if (self < 0) {
+        // no player to center the area of interest on
+        filtered->reserve(snapshot->size());
+        for (uint32_t i = 0; i < snapshot->size(); i++) {
+            filtered->add(snapshot, i);
+        }
+        return filtered;
+    }
+    auto center = snapshot->translations()[self];
+    auto previous = sent_->latest();
+
+    selected_.clear();
+    carried_.clear();
+
+    // the client's own player is always sent
+    selected_.push_back(std::make_pair(id_, true));
+    int64_t remaining = int64_t(budget_) - snapshot->cost(self, SnapshotField::ALL);
+
+    // accumulate priority for every other player in range
+    candidates_.clear();
+    index->query(center, interest_.radius, slots_);
+    for (auto slot : slots_) {
+        auto id = snapshot->ids()[slot];
+        if (id == id_) {
+            continue;
+        }
+        int32_t sent = previous ? previous->find(id) : -1;
+        auto priority = carriedPriority(priorities_, id) + weight(snapshot, slot, previous, sent, center);
+        if (sent >= 0 && priority < 1.0f) {
+            // not due yet, the client keeps the last state it was sent
+            selected_.push_back(std::make_pair(id, false));
+            carried_.push_back(std::make_pair(id, priority));
+            continue;
+        }
+        candidates_.push_back(std::make_pair(priority, slot));
+    }
+
+    // send the highest priority players that fit in the budget, only
+    // ordering as many as there is room left to try
+    std::make_heap(candidates_.begin(), candidates_.end());
+    auto end = candidates_.end();
+    while (end != candidates_.begin() && remaining >= MIN_PLAYER_SIZE) {
+        std::pop_heap(candidates_.begin(), end);
+        end--;
+        const auto& candidate = *end;
+        auto slot = candidate.second;
+        auto id = snapshot->ids()[slot];
+        int32_t sent = previous ? previous->find(id) : -1;
+        int64_t cost = snapshot->cost(slot, sent >= 0 ? snapshot->diff(slot, previous, sent) : uint8_t(SnapshotField::ALL));
+        if (cost <= remaining) {
+            selected_.push_back(std::make_pair(id, true));
+            remaining -= cost;
+            continue;
+        }
+        // over budget, carry the priority over to the next snapshot
+        if (sent >= 0) {
+            selected_.push_back(std::make_pair(id, false));
+        }
+        carried_.push_back(std::make_pair(id, candidate.first));
+    }
+    // no room left for the rest at all
+    for (auto iter = candidates_.begin(); iter != end; iter++) {
+        auto id = snapshot->ids()[iter->second];
+        if (previous && previous->find(id) >= 0) {
+            selected_.push_back(std::make_pair(id, false));
+        }
+        carried_.push_back(std::make_pair(id, iter->first));
+    }
+    std::sort(carried_.begin(), carried_.end());
+    priorities_.swap(carried_);
+
+    // snapshots are built in id order
+    std::sort(selected_.begin(), selected_.end());
+    filtered->reserve(selected_.size());
+    for (const auto& entry : selected_) {
+        if (entry.second) {
+            filtered->add(snapshot, snapshot->find(entry.first));
+        } else {
+            filtered->add(previous, previous->find(entry.first));
+        }
+    }
+    return filtered;
+}
+
+StreamBuffer::Shared ClientView::serialize(const Snapshot::Shared& snapshot)
+{
+    auto base = baseline();
+    auto stream = StreamBuffer::alloc();
+    stream << uint8_t(PayloadType::SNAPSHOT);
+    stream << (base ? base->id() : NO_SNAPSHOT); // baseline id
+    stream << inputAck_; // newest input received
+    serializeDelta(stream, base, snapshot);
+    sent_->add(snapshot);
+    return stream;
+}
@@ -1,7 +1,14 @@
 #include "game/Frame.h"
 
+#include "game/Idle.h"
+#include "game/StateType.h"
 #include "time/Time.h"
 
+#include <glm/ext.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
 Frame::Shared Frame::alloc()
 {
     return std::make_shared<Frame>();
@@ -12,28 +19,195 @@ Frame::Frame()
 {
 }
 
-void Frame::addPlayer(uint32_t id, Player::Shared player)
+uint32_t Frame::add(uint32_t id)
+{
+    return add(id,
+        glm::vec3(0, 0, 0),
+        glm::quat(1, 0, 0, 0),
+        glm::vec3(1, 1, 1),
+        Idle::alloc(nullptr));
+}
+
+uint32_t Frame::add(
+    uint32_t id,
+    const glm::vec3& translation,
+    const glm::quat& rotation,
+    const glm::vec3& scale,
+    State::Shared state)
 {
-    players_[id] = player;
+    int32_t existing = find(id);
+    if (existing >= 0) {
+        uint32_t index = existing;
+        translations_[index] = translation;
+        rotations_[index] = rotation;
+        scales_[index] = scale;
+        states_[index] = state;
+        return index;
+    }
+    // keep the arrays ordered by id, ids mostly arrive in order so this is
+    // usually an append
+    uint32_t index = std::lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin();
+    ids_.insert(ids_.begin() + index, id);
+    translations_.insert(translations_.begin() + index, translation);
+    rotations_.insert(rotations_.begin() + index, rotation);
+    scales_.insert(scales_.begin() + index, scale);
+    states_.insert(states_.begin() + index, state);
+    reindex(index);
+    return index;
+}
+
+void Frame::remove(uint32_t id)
+{
+    int32_t found = find(id);
+    if (found < 0) {
+        return;
+    }
+    uint32_t index = found;
+    ids_.erase(ids_.begin() + index);
+    translations_.erase(translations_.begin() + index);
+    rotations_.erase(rotations_.begin() + index);
+    scales_.erase(scales_.begin() + index);
+    states_.erase(states_.begin() + index);
+    indices_.erase(id);
+    reindex(index);
 }
 
-void Frame::removePlayer(uint32_t id)
+void Frame::clear()
 {
-    players_.erase(id);
+    ids_.clear();
+    translations_.clear();
+    rotations_.clear();
+    scales_.clear();
+    states_.clear();
+    indices_.clear();
 }
 
-Player::Shared Frame::player(uint32_t id) const
+void Frame::reindex(uint32_t from)
 {
-    auto iter = players_.find(id);
-    if (iter != players_.end()) {
+    for (uint32_t i = from; i < ids_.size(); i++) {
+        indices_[ids_[i]] = i;
+    }
+}
+
+int32_t Frame::find(uint32_t id) const
+{
+    auto iter = indices_.find(id);
+    if (iter != indices_.end()) {
         return iter->second;
     }
-    return nullptr;
+    return -1;
+}
+
+uint32_t Frame::size() const
+{
+    return ids_.size();
+}
+
+const std::vector<uint32_t>& Frame::ids() const
+{
+    return ids_;
+}
+
+const std::vector<glm::vec3>& Frame::translations() const
+{
+    return translations_;
+}
+
+const std::vector<glm::quat>& Frame::rotations() const
+{
+    return rotations_;
+}
+
+const std::vector<glm::vec3>& Frame::scales() const
+{
+    return scales_;
+}
+
+const std::vector<State::Shared>& Frame::states() const
+{
+    return states_;
+}
+
+void Frame::setTranslation(uint32_t index, const glm::vec3& translation)
+{
+    translations_[index] = translation;
+}
+
+void Frame::setRotation(uint32_t index, const glm::quat& rotation)
+{
+    rotations_[index] = rotation;
 }
 
-const std::map<uint32_t, Player::Shared>& Frame::players() const
+void Frame::rotateGlobal(uint32_t index, float32_t angle, const glm::vec3& axis)
 {
-    return players_;
+    rotations_[index] = glm::angleAxis(angle, axis) * rotations_[index];
+}
+
+void Frame::moveAlong(uint32_t index, const glm::vec3& translation, const Environment::Shared& env)
+{
+    auto origin = translations_[index] + translation;
+    auto intersection = env->intersect(
+        glm::vec3(0, -1, 0),
+        origin,
+        false, -false);
+    if (intersection.hit) {
+        translations_[index] = intersection.position;
+    }
+}
+
+glm::vec3 Frame::forward(uint32_t index) const
+{
+    const glm::quat& rotation = rotations_[index];
+    float32_t xx = rotation.x * rotation.x,
+              yy = rotation.y * rotation.y,
+              xz = rotation.x * rotation.z,
+              xw = rotation.x * rotation.w,
+              yz = rotation.y * rotation.z,
+              yw = rotation.y * rotation.w;
+    return -glm::normalize(glm::vec3(2 * xz + 2 * yw, 2 * yz - 2 * xw, 1 - 2 * xx - 2 * yy));
+}
+
+glm::mat4 Frame::matrix(uint32_t index) const
+{
+    return glm::translate(glm::mat4(1.0f), translations_[index])
+        * glm::mat4_cast(rotations_[index])
+        * glm::scale(glm::mat4(1.0f), scales_[index]);
+}
+
+Transform::Shared Frame::transform(uint32_t index) const
+{
+    auto transform = Transform::alloc();
+    transform->setTranslation(translations_[index]);
+    transform->setRotation(rotations_[index]);
+    transform->setScale(scales_[index]);
+    return transform;
+}
+
+void Frame::handleInput(uint32_t index, const Input::Shared& input)
+{
+    if (states_[index]) {
+        auto next = states_[index]->handleInput(input);
+        if (next) {
+            states_[index] = next;
+        }
+    }
+}
+
+void Frame::update(uint32_t index, const Environment::Shared& env, std::time_t dt)
+{
+    if (states_[index]) {
+        auto next = states_[index]->update(*this, index, env, dt);
+        if (next) {
+            states_[index] = next;
+        }
+    }
+}
+
+void Frame::update(const Environment::Shared& env, std::time_t dt)
+{
+    for (uint32_t i = 0; i < ids_.size(); i++) {
+        update(i, env, dt);
+    }
 }
 
 std::time_t Frame::timestamp() const
@@ -49,10 +223,13 @@ void Frame::setTimestamp(std::time_t timestamp)
 StreamBuffer::Shared& operator<<(StreamBuffer::Shared& stream, const Frame::Shared& frame)
 {
     stream << frame->timestamp_; // timestamp
-    stream << uint32_t(frame->players_.size()); // player count
-    for (auto iter : frame->players_) {
-        stream << iter.first; // id
-        stream << iter.second; // player
+    stream << uint32_t(frame->ids_.size()); // player count
+    for (uint32_t i = 0; i < frame->ids_.size(); i++) {
+        stream << frame->ids_[i]; // id
+        stream << frame->translations_[i]; // translation
+        stream << frame->rotations_[i]; // rotation
+        stream << frame->scales_[i]; // scale
+        serializeState(stream, frame->states_[i]); // state
     }
     return stream;
 }
@@ -63,11 +240,15 @@ StreamBuffer::Shared& operator>>(StreamBuffer::Shared& stream, Frame::Shared& fr
     uint32_t size = 0;
     stream >> size; // player count
     for (uint32_t i = 0; i < size; i++) {
-        uint32_t id;
+        uint32_t id = 0;
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
         stream >> id; // id
-        auto player = Player::alloc(id);
-        stream >> player; // player
-        frame->players_[id] = player;
+        stream >> translation; // translation
+        stream >> rotation; // rotation
+        stream >> scale; // scale
+        frame->add(id, translation, rotation, scale, deserializeState(stream)); // state
     }
     return stream;
 }
@@ -78,36 +259,31 @@ Frame::Shared interpolate(const Frame::Shared& a, const Frame::Shared& b, float3
     auto frame = Frame::alloc();
     frame->setTimestamp(a->timestamp() + ((b->timestamp() - a->timestamp()) * t));
 
-    // get all player ids in both frames
-    std::set<uint32_t> ids;
-    for (auto iter : a->players()) {
-        ids.insert(iter.first);
-    }
-    for (auto iter : b->players()) {
-        ids.insert(iter.first);
-    }
-
-    // interpolate new frame state
-    for (auto id : ids) {
-        auto pa = a->players().find(id);
-        auto pb = b->players().find(id);
-
-        auto aExists = pa != a->players().end();
-        auto bExists = pb != b->players().end();
-
-        if (!aExists && bExists) {
-            // new player
-            frame->addPlayer(id, pb->second);
-            continue;
+    // both frames are ordered by id, so walk them together
+    const auto& aIds = a->ids();
+    const auto& bIds = b->ids();
+    uint32_t i = 0;
+    for (uint32_t j = 0; j < bIds.size(); j++) {
+        auto id = bIds[j];
+        // skip players that are gone
+        while (i < aIds.size() && aIds[i] < id) {
+            i++;
         }
-
-        if (aExists && !bExists) {
-            // player is gone
+        if (i == aIds.size() || aIds[i] != id) {
+            // new player
+            frame->add(id,
+                b->translations()[j],
+                b->rotations()[j],
+                b->scales()[j],
+                b->states()[j]);
             continue;
         }
-
         // interpolate
-        frame->addPlayer(id, interpolate(pa->second, pb->second, t));
+        frame->add(id,
+            glm::lerp(a->translations()[i], b->translations()[j], t),
+            glm::slerp(a->rotations()[i], b->rotations()[j], t),
+            glm::lerp(a->scales()[i], b->scales()[j], t),
+            b->states()[j]);
     }
     return frame;
 }
@@ -30,7 +30,7 @@ State::Shared Idle::handleInput(const Input::Shared& input)
     return nullptr;
 }
 
-State::Shared Idle::update(Player::Shared& player, Environment::Shared env, std::time_t t)
+State::Shared Idle::update(Frame& frame, uint32_t index, Environment::Shared env, std::time_t t)
 {
     return nullptr;
 }
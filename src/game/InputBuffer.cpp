@@ -0,0 +1,81 @@
+#include "game/InputBuffer.h"
+
+#include "game/PayloadType.h"
+
+#include <algorithm>
+
+InputBuffer::Shared InputBuffer::alloc(uint32_t batchSize)
+{
+    return std::make_shared<InputBuffer>(batchSize);
+}
+
+InputBuffer::InputBuffer(uint32_t batchSize)
+    : batchSize_(std::max(1u, std::min(255u, batchSize)))
+    , sequence_(0)
+{
+}
+
+uint32_t InputBuffer::add(const Input::Shared& input)
+{
+    // sequence numbers start at 1, 0 is reserved for "none"
+    if (++sequence_ == 0) {
+        sequence_++;
+    }
+    pending_.push_back(std::make_pair(sequence_, input));
+    return sequence_;
+}
+
+void InputBuffer::ack(uint32_t sequence)
+{
+    while (!pending_.empty() && !isNewer(pending_.front().first, sequence)) {
+        pending_.pop_front();
+    }
+}
+
+bool InputBuffer::empty() const
+{
+    return pending_.empty();
+}
+
+void InputBuffer::clear()
+{
+    // NOTE: the sequence carries on, the server may still remember it
+    pending_.clear();
+}
+
+StreamBuffer::Shared InputBuffer::serialize(std::time_t viewTime) const
+{
+    auto stream = StreamBuffer::alloc();
+    stream << uint8_t(PayloadType::INPUT);
+    stream << viewTime;
+    // sequence numbers are consecutive, so only the first is written
+    stream << (pending_.empty() ? 0 : pending_.front().first);
+    // the oldest first, the server can't apply the newer ones without them
+    uint32_t count = std::min(uint32_t(pending_.size()), batchSize_);
+    stream << uint8_t(count);
+    for (uint32_t i = 0; i < count; i++) {
+        stream << pending_[i].second;
+    }
+    return stream;
+}
+
+std::vector<std::pair<uint32_t, Input::Shared> > deserializeInputs(StreamBuffer::Shared& stream, std::time_t& viewTime)
+{
+    stream >> viewTime;
+    uint32_t first = 0;
+    uint8_t count = 0;
+    stream >> first;
+    stream >> count;
+    std::vector<std::pair<uint32_t, Input::Shared> > inputs;
+    for (uint32_t i = 0; i < count; i++) {
+        auto input = Input::alloc(0);
+        stream >> input;
+        uint32_t sequence = first + i;
+        // skip the reserved sequence number on wrap around
+        if (sequence < first) {
+            sequence++;
+        }
+        inputs.push_back(std::make_pair(sequence, input));
+    }
+    return inputs;
+}
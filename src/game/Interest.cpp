@@ -0,0 +1,8 @@
+#include "game/Interest.h"
+
+Interest::Interest(float32_t radius, float32_t nearRadius, uint32_t farInterval)
+    : radius(radius)
+    , nearRadius(nearRadius)
+    , farInterval(farInterval)
+{
+}
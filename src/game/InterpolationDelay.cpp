@@ -0,0 +1,111 @@
+#include "game/InterpolationDelay.h"
+
+#include "game/Game.h"
+
+#include <algorithm>
+
+// number of arrivals measured
+const uint32_t WINDOW = 64;
+
+// fraction of arrivals that should find the frame they need already held
+const float64_t PERCENTILE = 0.95;
+
+// steps held on top of the measure for arrivals later than any seen so far
+const float64_t MARGIN = 0.25;
+
+// the target only shrinks by more than this many steps once it has held for
+// a while
+const float64_t HYSTERESIS = 0.5;
+const std::time_t SHRINK_HOLD = 2000000;
+
+// fraction faster or slower than real time the delay moves at, running out
+// of frames is worse than a slightly faster playback
+const float64_t GROW_RATE = 0.2;
+const float64_t SHRINK_RATE = 0.05;
+
+InterpolationDelay::Shared InterpolationDelay::alloc(std::time_t stepDuration, std::time_t min, std::time_t max)
+{
+    return std::make_shared<InterpolationDelay>(stepDuration, min, max);
+}
+
+InterpolationDelay::InterpolationDelay(std::time_t stepDuration, std::time_t min, std::time_t max)
+    : stepDuration_(stepDuration)
+    , min_(min)
+    , max_(std::max(min, max))
+    , lateness_(WINDOW, 0)
+    , next_(0)
+    , count_(0)
+    , newest_(0)
+    , delay_(0)
+    , target_(0)
+    , lower_(0)
+{
+    sorted_.reserve(WINDOW);
+    clear();
+}
+
+void InterpolationDelay::add(std::time_t timestamp, std::time_t arrival)
+{
+    if (newest_ != 0) {
+        lateness_[next_] = arrival - newest_;
+        next_ = (next_ + 1) % WINDOW;
+        count_ = std::min(count_ + 1, WINDOW);
+    }
+    // frames older than one held don't help
+    newest_ = std::max(newest_, timestamp);
+}
+
+void InterpolationDelay::update(std::time_t elapsed)
+{
+    if (count_ >= WINDOW / 4) {
+        auto measured = measure();
+        if (measured >= target_) {
+            // grow straight away, running out of frames is visible
+            target_ = measured;
+            lower_ = 0;
+        } else if (target_ - measured > HYSTERESIS * stepDuration_) {
+            lower_ += elapsed;
+            if (lower_ >= SHRINK_HOLD) {
+                target_ = measured;
+                lower_ = 0;
+            }
+        } else {
+            lower_ = 0;
+        }
+    }
+    // adjust the playback rate rather than jumping
+    if (delay_ < target_) {
+        delay_ = std::min(float64_t(target_), delay_ + GROW_RATE * elapsed);
+    } else if (delay_ > target_) {
+        delay_ = std::max(float64_t(target_), delay_ - SHRINK_RATE * elapsed);
+    }
+}
+
+void InterpolationDelay::clear()
+{
+    next_ = 0;
+    count_ = 0;
+    newest_ = 0;
+    target_ = std::max(min_, std::min(max_, std::time_t(Game::INTERPOLATION_STEPS * stepDuration_)));
+    delay_ = target_;
+    lower_ = 0;
+}
+
+std::time_t InterpolationDelay::delay() const
+{
+    return delay_;
+}
+
+std::time_t InterpolationDelay::target() const
+{
+    return target_;
+}
+
+std::time_t InterpolationDelay::measure() const
+{
+    // the order of the ring doesn't matter, only which samples are in it
+    sorted_.assign(lateness_.begin(), lateness_.begin() + count_);
+    auto nth = sorted_.begin() + std::min(sorted_.size() - 1, size_t(sorted_.size() * PERCENTILE));
+    std::nth_element(sorted_.begin(), nth, sorted_.end());
+    return std::max(min_, std::min(max_, *nth + std::time_t(MARGIN * stepDuration_)));
+}
@@ -1,5 +1,6 @@
 #include "game/MoveDirection.h"
 
+#include "game/Frame.h"
 #include "game/Idle.h"
 #include "game/InputType.h"
 #include "game/MoveTo.h"
@@ -46,16 +47,16 @@ State::Shared MoveDirection::handleInput(const Input::Shared& input)
     return nullptr;
 }
 
-State::Shared MoveDirection::update(Player::Shared& player, Environment::Shared env, std::time_t dt)
+State::Shared MoveDirection::update(Frame& frame, uint32_t index, Environment::Shared env, std::time_t dt)
 {
     auto fdt = Time::toSeconds(dt);
     auto translation = direction_ * fdt * PLAYER_SPEED;
-    auto a = -player->transform()->z();
+    auto a = frame.forward(index);
     auto b = glm::normalize(translation);
     auto angle = Math::signedAngle(a, b, glm::vec3(0, 1, 0));
     auto nval = std::min(angle, angle * float32_t(fdt) * PLAYER_SPEED);
-    player->transform()->rotateGlobal(nval, glm::vec3(0, 1, 0));
-    player->moveAlong(translation, env);
+    frame.rotateGlobal(index, nval, glm::vec3(0, 1, 0));
+    frame.moveAlong(index, translation, env);
     return nullptr;
 }
 
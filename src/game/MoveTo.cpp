@@ -1,5 +1,6 @@
 #include "game/MoveTo.h"
 
+#include "game/Frame.h"
 #include "game/Idle.h"
 #include "game/InputType.h"
 #include "game/MoveDirection.h"
@@ -45,9 +46,9 @@ State::Shared MoveTo::handleInput(const Input::Shared& input)
     return nullptr;
 }
 
-State::Shared MoveTo::update(Player::Shared& player, Environment::Shared env, std::time_t dt)
+State::Shared MoveTo::update(Frame& frame, uint32_t index, Environment::Shared env, std::time_t dt)
 {
-    auto diff = position_ - player->transform()->translation();
+    auto diff = position_ - frame.translations()[index];
     auto dist = glm::length(diff);
     auto fdt = Time::toSeconds(dt);
     dist = std::min(float32_t(fdt) * PLAYER_SPEED, dist);
@@ -57,15 +58,15 @@ State::Shared MoveTo::update(Player::Shared& player, Environment::Shared env, st
     auto direction = glm::normalize(diff);
     auto translation = direction * dist;
 
-    auto src = -player->transform()->z();
+    auto src = frame.forward(index);
     auto dst = glm::normalize(translation);
 
     auto angle = Math::signedAngle(src, dst, glm::vec3(0, 1, 0));
     auto nval = std::min(angle, angle * dist);
 
-    player->transform()->rotateGlobal(nval, glm::vec3(0, 1, 0));
+    frame.rotateGlobal(index, nval, glm::vec3(0, 1, 0));
 
-    player->moveAlong(translation, env);
+    frame.moveAlong(index, translation, env);
 
     return nullptr;
 }
@@ -0,0 +1,215 @@
+#include "game/PlayerHistory.h"
+
+#include "game/Game.h"
+#include "log/Log.h"
+#include "math/Transform.h"
+
+#include <algorithm>
+#include <cmath>
+
+PlayerHistory::Shared PlayerHistory::alloc(uint32_t capacity, uint32_t maxPlayers)
+{
+    return std::make_shared<PlayerHistory>(capacity, maxPlayers);
+}
+
+PlayerHistory::PlayerHistory(uint32_t capacity, uint32_t maxPlayers)
+    : capacity_(std::max(1u, capacity))
+    , maxPlayers_(maxPlayers)
+    , ticks_(capacity_)
+    , pool_(size_t(capacity_) * maxPlayers)
+    , head_(0)
+    , count_(0)
+{
+    scratch_.reserve(maxPlayers);
+}
+
+void PlayerHistory::record(const Frame::Shared& frame)
+{
+    if (count_ > 0 && frame->timestamp() <= newest()) {
+        // rewinding relies on the ticks being in order
+        return;
+    }
+    // overwrite the oldest tick once full
+    uint32_t index = (head_ + count_) % capacity_;
+    if (count_ == capacity_) {
+        head_ = (head_ + 1) % capacity_;
+    } else {
+        count_++;
+    }
+    Tick& tick = ticks_[index];
+    tick.timestamp = frame->timestamp();
+    tick.count = 0;
+    PlayerRecord* records = &pool_[size_t(index) * maxPlayers_];
+    const auto& ids = frame->ids();
+    const auto& translations = frame->translations();
+    const auto& rotations = frame->rotations();
+    for (uint32_t i = 0; i < ids.size(); i++) {
+        if (tick.count == maxPlayers_) {
+            LOG_WARN("More than " << maxPlayers_ << " players, not recording the rest");
+            break;
+        }
+        PlayerRecord& record = records[tick.count++];
+        record.id = ids[i];
+        record.translation = translations[i];
+        record.rotation = rotations[i];
+    }
+}
+
+void PlayerHistory::clear()
+{
+    head_ = 0;
+    count_ = 0;
+}
+
+std::time_t PlayerHistory::oldest() const
+{
+    return count_ > 0 ? ticks_[slot(0)].timestamp : 0;
+}
+
+std::time_t PlayerHistory::newest() const
+{
+    return count_ > 0 ? ticks_[slot(count_ - 1)].timestamp : 0;
+}
+
+size_t PlayerHistory::size() const
+{
+    return ticks_.size() * sizeof(Tick) + pool_.size() * sizeof(PlayerRecord);
+}
+
+uint32_t PlayerHistory::slot(uint32_t n) const
+{
+    return (head_ + n) % capacity_;
+}
+
+const PlayerRecord* PlayerHistory::records(uint32_t index) const
+{
+    return &pool_[size_t(index) * maxPlayers_];
+}
+
+uint32_t PlayerHistory::find(std::time_t time, float32_t& t) const
+{
+    // find the first tick at or after the time
+    uint32_t lo = 0;
+    uint32_t hi = count_ - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (ticks_[slot(mid)].timestamp < time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    const Tick& b = ticks_[slot(lo)];
+    const Tick& a = ticks_[slot(lo > 0 ? lo - 1 : 0)];
+    t = 1.0f;
+    if (b.timestamp > a.timestamp) {
+        t = float32_t(time - a.timestamp) / float32_t(b.timestamp - a.timestamp);
+        t = std::max(0.0f, std::min(1.0f, t));
+    }
+    return lo;
+}
+
+void PlayerHistory::rewind(std::time_t time, std::vector<PlayerRecord>& out, bool rotations) const
+{
+    out.clear();
+    if (count_ == 0) {
+        return;
+    }
+    float32_t t = 0;
+    uint32_t n = find(time, t);
+    const Tick& a = ticks_[slot(n > 0 ? n - 1 : 0)];
+    const Tick& b = ticks_[slot(n)];
+    const PlayerRecord* ra = records(slot(n > 0 ? n - 1 : 0));
+    const PlayerRecord* rb = records(slot(n));
+    // both ticks are ordered by id, players in only one of them are taken
+    // as they are there
+    uint32_t i = 0;
+    uint32_t j = 0;
+    while (i < a.count || j < b.count) {
+        if (j == b.count || (i < a.count && ra[i].id < rb[j].id)) {
+            out.push_back(ra[i++]);
+        } else if (i == a.count || rb[j].id < ra[i].id) {
+            out.push_back(rb[j++]);
+        } else {
+            out.push_back(rb[j]);
+            PlayerRecord& record = out.back();
+            record.translation = ra[i].translation + (rb[j].translation - ra[i].translation) * t;
+            if (rotations) {
+                record.rotation = glm::slerp(ra[i].rotation, rb[j].rotation, t);
+            }
+            i++;
+            j++;
+        }
+    }
+}
+
+void PlayerHistory::rewind(std::time_t time, std::vector<PlayerRecord>& out) const
+{
+    rewind(time, out, true);
+}
+
+bool PlayerHistory::raycast(
+    std::time_t time,
+    const glm::vec3& origin,
+    const glm::vec3& direction,
+    uint32_t ignore,
+    uint32_t& id,
+    Intersection& intersection) const
+{
+    // players are tested as spheres, so their rotations aren't needed
+    rewind(time, scratch_, false);
+    auto dir = glm::normalize(direction);
+    float32_t nearest = 0;
+    glm::vec3 center;
+    bool hit = false;
+    for (const auto& record : scratch_) {
+        if (record.id == ignore) {
+            continue;
+        }
+        // players are tested as their bounding sphere
+        auto diff = origin - record.translation;
+        float32_t b = glm::dot(diff, dir);
+        float32_t c = glm::dot(diff, diff) - Game::PLAYER_RADIUS * Game::PLAYER_RADIUS;
+        float32_t discriminant = b * b - c;
+        if (discriminant < 0) {
+            continue;
+        }
+        float32_t distance = -b - std::sqrt(discriminant);
+        if (distance < 0) {
+            // starts inside the sphere
+            distance = 0;
+            if (c > 0) {
+                // behind the ray
+                continue;
+            }
+        }
+        if (!hit || distance < nearest) {
+            nearest = distance;
+            center = record.translation;
+            id = record.id;
+            hit = true;
+        }
+    }
+    if (hit) {
+        auto position = origin + dir * nearest;
+        auto normal = position - center;
+        intersection = Intersection(
+            position,
+            glm::dot(normal, normal) > M_EPSILON ? glm::normalize(normal) : -dir,
+            nearest);
+    }
+    return hit;
+}
+
+void PlayerHistory::overlap(std::time_t time, const glm::vec3& center, float32_t radius, std::vector<uint32_t>& ids) const
+{
+    rewind(time, scratch_, false);
+    ids.clear();
+    float32_t reach = radius + Game::PLAYER_RADIUS;
+    for (const auto& record : scratch_) {
+        auto diff = record.translation - center;
+        if (glm::dot(diff, diff) <= reach * reach) {
+            ids.push_back(record.id);
+        }
+    }
+}
@@ -0,0 +1,142 @@
+#include "game/Prediction.h"
+
+#include "game/Game.h"
+
+#include <algorithm>
+#include <cmath>
+
+// time for the rendered player to close most of a misprediction
+const float64_t ERROR_DECAY = 100000;
+
+// errors larger than this are teleports, not mispredictions
+const float32_t MAX_ERROR = 4.0f;
+
+// copy of a player that can be simulated without touching the original,
+// states are not changed by updating so they can be shared
+static Frame::Shared copyPlayer(const Frame::Shared& frame, uint32_t index)
+{
+    auto copy = Frame::alloc();
+    copy->setTimestamp(frame->timestamp());
+    copy->add(frame->ids()[index],
+        frame->translations()[index],
+        frame->rotations()[index],
+        frame->scales()[index],
+        frame->states()[index]);
+    return copy;
+}
+
+Prediction::Shared Prediction::alloc()
+{
+    return std::make_shared<Prediction>();
+}
+
+Prediction::Prediction()
+    : player_(nullptr)
+    , time_(0)
+    , reconciled_(0)
+    , error_(0, 0, 0)
+    , stepDuration_(Game::STEP_DURATION)
+{
+}
+
+void Prediction::add(uint32_t sequence, const Input::Shared& input, std::time_t time)
+{
+    // kept until the server acknowledges it, however many are in flight
+    history_.push_back(Entry(sequence, input, time));
+    if (player_) {
+        player_->handleInput(0, input);
+    }
+}
+
+void Prediction::update(const Environment::Shared& env, std::time_t now)
+{
+    if (!player_) {
+        return;
+    }
+    if (now > time_) {
+        player_->update(0, env, now - time_);
+        // close the gap left by the last misprediction
+        error_ = error_ * float32_t(std::exp(-(now - time_) / ERROR_DECAY));
+    }
+    time_ = now;
+}
+
+void Prediction::reconcile(
+    const Frame::Shared& authoritative,
+    uint32_t id,
+    uint32_t inputAck,
+    const Environment::Shared& env,
+    std::time_t now)
+{
+    int32_t index = authoritative->find(id);
+    if (index < 0) {
+        return;
+    }
+    auto timestamp = authoritative->timestamp();
+    if (player_ && timestamp <= reconciled_) {
+        // older than the state already reconciled against
+        return;
+    }
+    reconciled_ = timestamp;
+    // the server's state includes every input up to the ack
+    while (inputAck != 0 && !history_.empty() && !isNewer(history_.front().sequence, inputAck)) {
+        history_.pop_front();
+    }
+    auto player = copyPlayer(authoritative, index);
+    auto iter = history_.begin();
+    auto time = timestamp;
+    while (true) {
+        // the server applies the inputs that arrive during a step before
+        // updating, so they take effect from its start
+        auto end = std::min(now, time + stepDuration_);
+        for (; iter != history_.end() && iter->time <= end; iter++) {
+            player->handleInput(0, iter->input);
+        }
+        if (end <= time) {
+            break;
+        }
+        player->update(0, env, end - time);
+        time = end;
+    }
+    for (; iter != history_.end(); iter++) {
+        player->handleInput(0, iter->input);
+    }
+    if (player_) {
+        // keep rendering where we were and ease over to the correction
+        error_ += player_->translations()[0] - player->translations()[0];
+        if (glm::length(error_) > MAX_ERROR) {
+            error_ = glm::vec3(0, 0, 0);
+        }
+    }
+    player_ = player;
+    time_ = now;
+}
+
+void Prediction::clear()
+{
+    history_.clear();
+    player_ = nullptr;
+    time_ = 0;
+    reconciled_ = 0;
+    error_ = glm::vec3(0, 0, 0);
+}
+
+void Prediction::setStepDuration(std::time_t duration)
+{
+    stepDuration_ = std::max(std::time_t(1), duration);
+}
+
+Transform::Shared Prediction::player() const
+{
+    if (!player_) {
+        return nullptr;
+    }
+    auto transform = player_->transform(0);
+    transform->translateGlobal(error_);
+    return transform;
+}
+
+float32_t Prediction::error() const
+{
+    return glm::length(error_);
+}
@@ -0,0 +1,355 @@
+#include "game/Snapshot.h"
+
+#include "game/StateType.h"
+#include "log/Log.h"
+
+#include <algorithm>
+#include <cstring>
+
+// no player update is smaller than its id and field mask
+const uint32_t MIN_PLAYER_SIZE = sizeof(uint32_t) + sizeof(uint8_t);
+
+// fills in a count written ahead of the entries it counts
+static void writeCount(StreamBuffer::Shared& stream, size_t pos, uint32_t count)
+{
+    size_t end = stream->tellp();
+    stream->seekp(pos);
+    stream << count;
+    stream->seekp(end);
+}
+
+Snapshot::Shared Snapshot::alloc(uint32_t id, std::time_t timestamp)
+{
+    return std::make_shared<Snapshot>(id, timestamp);
+}
+
+Snapshot::Shared Snapshot::alloc(uint32_t id, const Frame::Shared& frame)
+{
+    return std::make_shared<Snapshot>(id, frame);
+}
+
+Snapshot::Snapshot(uint32_t id, std::time_t timestamp)
+    : id_(id)
+    , timestamp_(timestamp)
+    , states_(StreamBuffer::alloc(1024, 0))
+    , offsets_(1, 0)
+{
+}
+
+Snapshot::Snapshot(uint32_t id, const Frame::Shared& frame)
+    : id_(id)
+    , timestamp_(frame->timestamp())
+    , ids_(frame->ids())
+    , translations_(frame->translations())
+    , rotations_(frame->rotations())
+    , scales_(frame->scales())
+    , states_(StreamBuffer::alloc(1024, 0))
+    , offsets_(1, 0)
+{
+    const auto& states = frame->states();
+    offsets_.reserve(states.size() + 1);
+    for (const auto& state : states) {
+        serializeState(states_, state);
+        offsets_.push_back(states_->size());
+    }
+}
+
+uint32_t Snapshot::id() const
+{
+    return id_;
+}
+
+std::time_t Snapshot::timestamp() const
+{
+    return timestamp_;
+}
+
+void Snapshot::reserve(uint32_t size)
+{
+    ids_.reserve(size);
+    translations_.reserve(size);
+    rotations_.reserve(size);
+    scales_.reserve(size);
+    offsets_.reserve(size + 1);
+}
+
+void Snapshot::add(
+    uint32_t id,
+    const glm::vec3& translation,
+    const glm::quat& rotation,
+    const glm::vec3& scale,
+    const uint8_t* state,
+    uint32_t stateSize)
+{
+    ids_.push_back(id);
+    translations_.push_back(translation);
+    rotations_.push_back(rotation);
+    scales_.push_back(scale);
+    states_->write(state, stateSize);
+    offsets_.push_back(states_->size());
+}
+
+void Snapshot::add(const Snapshot::Shared& other, uint32_t index)
+{
+    add(other->ids_[index],
+        other->translations_[index],
+        other->rotations_[index],
+        other->scales_[index],
+        other->state(index),
+        other->stateSize(index));
+}
+
+int32_t Snapshot::find(uint32_t id) const
+{
+    auto iter = std::lower_bound(ids_.begin(), ids_.end(), id);
+    if (iter == ids_.end() || *iter != id) {
+        return -1;
+    }
+    return iter - ids_.begin();
+}
+
+uint32_t Snapshot::size() const
+{
+    return ids_.size();
+}
+
+const std::vector<uint32_t>& Snapshot::ids() const
+{
+    return ids_;
+}
+
+const std::vector<glm::vec3>& Snapshot::translations() const
+{
+    return translations_;
+}
+
+const std::vector<glm::quat>& Snapshot::rotations() const
+{
+    return rotations_;
+}
+
+const std::vector<glm::vec3>& Snapshot::scales() const
+{
+    return scales_;
+}
+
+const uint8_t* Snapshot::state(uint32_t index) const
+{
+    return states_->data() + offsets_[index];
+}
+
+uint32_t Snapshot::stateSize(uint32_t index) const
+{
+    return offsets_[index + 1] - offsets_[index];
+}
+
+uint8_t Snapshot::diff(uint32_t index, const Snapshot::Shared& other, uint32_t otherIndex) const
+{
+    uint8_t mask = 0;
+    if (translations_[index] != other->translations_[otherIndex]) {
+        mask |= SnapshotField::TRANSLATION;
+    }
+    if (rotations_[index] != other->rotations_[otherIndex]) {
+        mask |= SnapshotField::ROTATION;
+    }
+    if (scales_[index] != other->scales_[otherIndex]) {
+        mask |= SnapshotField::SCALE;
+    }
+    uint32_t size = stateSize(index);
+    if (size != other->stateSize(otherIndex)
+        || std::memcmp(state(index), other->state(otherIndex), size) != 0) {
+        mask |= SnapshotField::STATE;
+    }
+    return mask;
+}
+
+uint32_t Snapshot::cost(uint32_t index, uint8_t mask) const
+{
+    uint32_t bytes = MIN_PLAYER_SIZE; // id and mask
+    if (mask & SnapshotField::TRANSLATION) {
+        bytes += 3 * sizeof(float32_t);
+    }
+    if (mask & SnapshotField::ROTATION) {
+        bytes += 4 * sizeof(float32_t);
+    }
+    if (mask & SnapshotField::SCALE) {
+        bytes += 3 * sizeof(float32_t);
+    }
+    if (mask & SnapshotField::STATE) {
+        bytes += sizeof(uint32_t) + stateSize(index);
+    }
+    return bytes;
+}
+
+Frame::Shared Snapshot::frame() const
+{
+    auto frame = Frame::alloc();
+    frame->setTimestamp(timestamp_);
+    for (uint32_t i = 0; i < ids_.size(); i++) {
+        // read each state from its own bytes, so one that doesn't parse
+        // can't shift the others
+        auto state = StreamBuffer::alloc(this->state(i), stateSize(i), states_);
+        frame->add(ids_[i],
+            translations_[i],
+            rotations_[i],
+            scales_[i],
+            deserializeState(state));
+    }
+    return frame;
+}
+
+StreamBuffer::Shared& serializeDelta(StreamBuffer::Shared& stream, const Snapshot::Shared& base, const Snapshot::Shared& snapshot)
+{
+    stream << snapshot->id_; // id
+    stream << snapshot->timestamp_; // timestamp
+
+    // both snapshots are ordered by id, so walk them together
+
+    // write removed players
+    size_t pos = stream->tellp();
+    stream << uint32_t(0); // removed count
+    uint32_t removed = 0;
+    if (base) {
+        uint32_t j = 0;
+        for (auto id : base->ids_) {
+            while (j < snapshot->ids_.size() && snapshot->ids_[j] < id) {
+                j++;
+            }
+            if (j == snapshot->ids_.size() || snapshot->ids_[j] != id) {
+                stream << id; // id
+                removed++;
+            }
+        }
+    }
+    writeCount(stream, pos, removed);
+
+    // write changed fields of changed and added players only
+    pos = stream->tellp();
+    stream << uint32_t(0); // changed count
+    uint32_t changed = 0;
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < snapshot->ids_.size(); i++) {
+        auto id = snapshot->ids_[i];
+        uint8_t mask = SnapshotField::ALL;
+        if (base) {
+            while (j < base->ids_.size() && base->ids_[j] < id) {
+                j++;
+            }
+            if (j < base->ids_.size() && base->ids_[j] == id) {
+                mask = snapshot->diff(i, base, j);
+            }
+        }
+        if (!mask) {
+            continue;
+        }
+        stream << id; // id
+        stream << mask; // changed fields
+        if (mask & SnapshotField::TRANSLATION) {
+            stream << snapshot->translations_[i];
+        }
+        if (mask & SnapshotField::ROTATION) {
+            stream << snapshot->rotations_[i];
+        }
+        if (mask & SnapshotField::SCALE) {
+            stream << snapshot->scales_[i];
+        }
+        if (mask & SnapshotField::STATE) {
+            stream << snapshot->stateSize(i);
+            stream->write(snapshot->state(i), snapshot->stateSize(i));
+        }
+        changed++;
+    }
+    writeCount(stream, pos, changed);
+    return stream;
+}
+
+Snapshot::Shared deserializeDelta(StreamBuffer::Shared& stream, const Snapshot::Shared& base)
+{
+    uint32_t id = 0;
+    stream >> id; // id
+    auto snapshot = Snapshot::alloc(id);
+    stream >> snapshot->timestamp_; // timestamp
+
+    std::vector<uint32_t> removed;
+    stream >> removed; // removed ids
+    if (stream->eof()) {
+        LOG_ERROR("Snapshot " << id << " is missing its changed players");
+        return nullptr;
+    }
+
+    uint32_t count = 0;
+    stream >> count; // changed count
+    if (count > stream->remaining() / MIN_PLAYER_SIZE) {
+        LOG_ERROR("Snapshot " << id << " claims " << count
+                              << " changed players, more than the "
+                              << stream->remaining() << " bytes remaining can hold");
+        return nullptr;
+    }
+    snapshot->reserve((base ? base->size() : 0) + count);
+
+    // merge the changed players into the baseline, both are ordered by id
+    uint32_t j = 0;
+    // copies the baseline players up to the index, other than removed ones
+    auto keep = [&](uint32_t end) {
+        for (; j < end; j++) {
+            if (!std::binary_search(removed.begin(), removed.end(), base->ids_[j])) {
+                snapshot->add(base, j);
+            }
+        }
+    };
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t playerId = 0;
+        uint8_t mask = 0;
+        stream >> playerId; // id
+        stream >> mask; // changed fields
+        if (i > 0 && playerId <= snapshot->ids_.back()) {
+            LOG_ERROR("Snapshot " << id << " has player " << playerId << " out of order");
+            return nullptr;
+        }
+        if (base) {
+            keep(std::lower_bound(base->ids_.begin() + j, base->ids_.end(), playerId) - base->ids_.begin());
+        }
+        // start from the baseline
+        glm::vec3 translation(0, 0, 0);
+        glm::quat rotation(1, 0, 0, 0);
+        glm::vec3 scale(1, 1, 1);
+        const uint8_t* state = nullptr;
+        uint32_t stateSize = 0;
+        if (base && j < base->ids_.size() && base->ids_[j] == playerId) {
+            translation = base->translations_[j];
+            rotation = base->rotations_[j];
+            scale = base->scales_[j];
+            state = base->state(j);
+            stateSize = base->stateSize(j);
+            j++;
+        } else if (!(mask & SnapshotField::STATE)) {
+            LOG_ERROR("Snapshot " << id << " adds player " << playerId << " without a state");
+            return nullptr;
+        }
+        if (mask & SnapshotField::TRANSLATION) {
+            stream >> translation;
+        }
+        if (mask & SnapshotField::ROTATION) {
+            stream >> rotation;
+        }
+        if (mask & SnapshotField::SCALE) {
+            stream >> scale;
+        }
+        if (mask & SnapshotField::STATE) {
+            stream >> stateSize;
+            if (stateSize > stream->remaining()) {
+                LOG_ERROR("Snapshot " << id << " has a state of " << stateSize
+                                      << " bytes, more than the "
+                                      << stream->remaining() << " bytes remaining");
+                return nullptr;
+            }
+            state = stream->data() + stream->tellg();
+            stream->seekg(stream->tellg() + stateSize);
+        }
+        snapshot->add(playerId, translation, rotation, scale, state, stateSize);
+    }
+    if (base) {
+        keep(base->ids_.size());
+    }
+    return snapshot;
+}
@@ -0,0 +1,39 @@
+#include "game/SnapshotHistory.h"
+
+SnapshotHistory::Shared SnapshotHistory::alloc(uint32_t capacity)
+{
+    return std::make_shared<SnapshotHistory>(capacity);
+}
+
+SnapshotHistory::SnapshotHistory(uint32_t capacity)
+    : snapshots_(capacity)
+{
+}
+
+void SnapshotHistory::add(Snapshot::Shared snapshot)
+{
+    snapshots_[snapshot->id() % snapshots_.size()] = snapshot;
+    if (!latest_ || isNewer(snapshot->id(), latest_->id())) {
+        latest_ = snapshot;
+    }
+}
+
+Snapshot::Shared SnapshotHistory::find(uint32_t id) const
+{
+    auto snapshot = snapshots_[id % snapshots_.size()];
+    if (snapshot && snapshot->id() == id) {
+        return snapshot;
+    }
+    return nullptr;
+}
+
+Snapshot::Shared SnapshotHistory::latest() const
+{
+    return latest_;
+}
+
+void SnapshotHistory::clear()
+{
+    snapshots_ = std::vector<Snapshot::Shared>(snapshots_.size());
+    latest_ = nullptr;
+}
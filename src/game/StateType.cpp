@@ -4,9 +4,8 @@
 #include "game/MoveDirection.h"
 #include "game/MoveTo.h"
 
-StreamBuffer::Shared& operator<<(StreamBuffer::Shared& stream, const StateMachine::Shared& machine)
+StreamBuffer::Shared& serializeState(StreamBuffer::Shared& stream, const State::Shared& state)
 {
-    auto state = machine->current();
     if (state) {
         stream << state->type();
         stream << state;
@@ -16,7 +15,7 @@ StreamBuffer::Shared& operator<<(StreamBuffer::Shared& stream, const StateMachin
     return stream;
 }
 
-StreamBuffer::Shared& operator>>(StreamBuffer::Shared& stream, StateMachine::Shared& machine)
+State::Shared deserializeState(StreamBuffer::Shared& stream)
 {
     // read type
     uint8_t type;
@@ -26,7 +25,7 @@ StreamBuffer::Shared& operator>>(StreamBuffer::Shared& stream, StateMachine::Sha
     switch (type) {
     case StateType::NONE:
         // no state, exit
-        return stream;
+        return nullptr;
 
     case StateType::IDLE:
         state = Idle::alloc();
@@ -40,7 +39,8 @@ StreamBuffer::Shared& operator>>(StreamBuffer::Shared& stream, StateMachine::Sha
         state = MoveTo::alloc();
         break;
     }
-    stream >> state;
-    machine->set(state);
-    return stream;
+    if (state) {
+        stream >> state;
+    }
+    return state;
 }
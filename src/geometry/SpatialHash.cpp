@@ -0,0 +1,61 @@
+#include "geometry/SpatialHash.h"
+
+#include <cmath>
+
+SpatialHash::Shared SpatialHash::alloc(float32_t cellSize)
+{
+    return std::make_shared<SpatialHash>(cellSize);
+}
+
+SpatialHash::SpatialHash(float32_t cellSize)
+    : cellSize_(cellSize)
+{
+}
+
+int32_t SpatialHash::cell(float32_t x) const
+{
+    return int32_t(std::floor(x / cellSize_));
+}
+
+uint64_t SpatialHash::key(int32_t x, int32_t z) const
+{
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(z);
+}
+
+void SpatialHash::insert(uint32_t id, const glm::vec3& position)
+{
+    auto k = key(cell(position.x), cell(position.z));
+    cells_[k].push_back(std::make_pair(id, position));
+}
+
+void SpatialHash::clear()
+{
+    // keep the buckets allocated, the same cells tend to be re-used
+    for (auto& iter : cells_) {
+        iter.second.clear();
+    }
+}
+
+void SpatialHash::query(const glm::vec3& center, float32_t radius, std::vector<uint32_t>& ids) const
+{
+    ids.clear();
+    auto radius2 = radius * radius;
+    auto minX = cell(center.x - radius);
+    auto maxX = cell(center.x + radius);
+    auto minZ = cell(center.z - radius);
+    auto maxZ = cell(center.z + radius);
+    for (auto x = minX; x <= maxX; x++) {
+        for (auto z = minZ; z <= maxZ; z++) {
+            auto iter = cells_.find(key(x, z));
+            if (iter == cells_.end()) {
+                continue;
+            }
+            for (const auto& entry : iter->second) {
+                auto diff = entry.second - center;
+                if (glm::dot(diff, diff) <= radius2) {
+                    ids.push_back(entry.first);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,267 @@
+#include "loopback/LoopbackClient.h"
+
+#include "Common.h"
+#include "log/Log.h"
+#include "time/Time.h"
+
+const uint8_t SERVER_ID = 0;
+
+LoopbackClient::Shared LoopbackClient::alloc(LoopbackServer::Shared server)
+{
+    return std::make_shared<LoopbackClient>(server);
+}
+
+LoopbackClient::LoopbackClient(LoopbackServer::Shared server)
+    : server_(server)
+    , connected_(false)
+    , id_(0)
+    , requests_(RequestTable::alloc())
+    , currentMsgId_(0)
+    , numQueued_(0)
+    , sequence_(0)
+    , hasSequence_(false)
+    , compression_(Compression::NONE)
+    , lastSample_(0)
+{
+}
+
+LoopbackClient::~LoopbackClient()
+{
+    // the server must not deliver to a destroyed client
+    disconnect();
+}
+
+bool LoopbackClient::connect(const std::string& host, uint32_t port)
+{
+    if (isConnected()) {
+        LOG_DEBUG("LoopbackClient is already connected to a server");
+        return 0;
+    }
+    if (!server_->isRunning() || server_->port() != port) {
+        LOG_ERROR("Connection to `" << host << ":" << port << "` failed");
+        return 1;
+    }
+    // discard anything received on the previous connection
+    received_.clear();
+    outgoing_.clear();
+    if (server_->connect(this, id_)) {
+        LOG_ERROR("Connection to `" << host << ":" << port << "` failed");
+        return 1;
+    }
+    LOG_DEBUG("Connection to `" << host << ":" << port << "` succeeded");
+    sequence_ = 0;
+    hasSequence_ = false;
+    stats_ = PeerStats();
+    last_ = PeerStats();
+    connected_ = true;
+    return 0;
+}
+
+bool LoopbackClient::disconnect()
+{
+    if (!isConnected()) {
+        return 0;
+    }
+    // deliver anything still queued before the disconnect, as ENet does
+    flush();
+    server_->disconnect(id_);
+    connected_ = false;
+    hasSequence_ = false;
+    outgoing_.clear();
+    // fail any outstanding requests
+    requests_->clear();
+    return 0;
+}
+
+bool LoopbackClient::isConnected() const
+{
+    return connected_;
+}
+
+void LoopbackClient::disconnected()
+{
+    // the server has stopped
+    LOG_DEBUG("Connection to server has been lost");
+    connected_ = false;
+    hasSequence_ = false;
+    outgoing_.clear();
+    received_.push_back(Message::alloc(SERVER_ID, MessageType::DISCONNECT));
+}
+
+void LoopbackClient::deliver(const LoopbackPacket& packet)
+{
+    auto msg = readPacket(SERVER_ID, packet);
+    stats_.messagesReceived++;
+    stats_.bytesReceived += packet.data->size();
+    // drop stale or out-of-order sequenced messages
+    if (packet.type == DeliveryType::SEQUENCED) {
+        // ids are shared by every peer, so the first is taken whatever it is
+        if (hasSequence_ && !isNewer(msg->id(), sequence_)) {
+            return;
+        }
+        sequence_ = msg->id();
+        hasSequence_ = true;
+    }
+    received_.push_back(msg);
+}
+
+void LoopbackClient::on(uint32_t id, RequestHandler handler)
+{
+    handlers_[id] = handler;
+}
+
+void LoopbackClient::setCompression(Compression type)
+{
+    // NOTE: there is no wire to save bytes on
+    compression_ = type;
+}
+
+CompressionStats LoopbackClient::compressionStats() const
+{
+    return CompressionStats();
+}
+
+void LoopbackClient::handleRequest(const Message::Shared& msg) const
+{
+    auto iter = handlers_.find(msg->requestId());
+    if (iter != handlers_.end()) {
+        auto handler = iter->second;
+        auto res = handler(SERVER_ID, msg->stream());
+        // respond with the id of the request message so the server can match
+        // it against its outstanding requests
+        sendResponse(msg->id(), res);
+    }
+}
+
+void LoopbackClient::sendResponse(uint32_t requestId, StreamBuffer::Shared stream) const
+{
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        requestId, // request id
+        MessageType::DATA_RESPONSE,
+        stream);
+    sendMessage(DeliveryType::RELIABLE, msg);
+}
+
+void LoopbackClient::sendMessage(DeliveryType type, Message::Shared msg) const
+{
+    auto packet = writePacket(type, msg);
+    stats_.messagesSent++;
+    stats_.bytesSent += packet.data->size();
+    outgoing_.push_back(packet);
+    // NOTE: the packet is delivered with everything else on `flush`
+    numQueued_++;
+}
+
+void LoopbackClient::send(DeliveryType type, StreamBuffer::Shared stream) const
+{
+    if (!isConnected()) {
+        LOG_DEBUG("LoopbackClient is not connected to any server");
+        return;
+    }
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        MessageType::DATA,
+        stream);
+    sendMessage(type, msg);
+}
+
+uint32_t LoopbackClient::sendRequest(uint32_t requestId, StreamBuffer::Shared stream) const
+{
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        requestId, // request id
+        MessageType::DATA_REQUEST,
+        stream);
+    sendMessage(DeliveryType::RELIABLE, msg);
+    return msg->id();
+}
+
+void LoopbackClient::request(uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
+{
+    if (!isConnected()) {
+        LOG_DEBUG("LoopbackClient is not connected to any server");
+        // fail immediately, there is no server to respond
+        if (handler) {
+            handler(nullptr);
+        }
+        return;
+    }
+    auto msgId = sendRequest(requestId, stream);
+    requests_->add(msgId, SERVER_ID, handler, timeout);
+}
+
+uint32_t LoopbackClient::flush()
+{
+    if (!isConnected() || outgoing_.empty()) {
+        numQueued_ = 0;
+        return 0;
+    }
+    // NOTE: swap first, delivering may queue responses
+    std::vector<LoopbackPacket> outgoing;
+    outgoing.swap(outgoing_);
+    for (const auto& packet : outgoing) {
+        server_->deliver(id_, packet);
+    }
+    numQueued_ = 0;
+    // everything is coalesced into a single datagram
+    return 1;
+}
+
+uint32_t LoopbackClient::numQueued() const
+{
+    return numQueued_;
+}
+
+std::vector<Message::Shared> LoopbackClient::poll()
+{
+    std::vector<Message::Shared> msgs;
+    // NOTE: swap first, handling requests may deliver more messages
+    std::vector<Message::Shared> received;
+    received.swap(received_);
+    for (auto msg : received) {
+        switch (msg->type()) {
+        case MessageType::DATA_RESPONSE:
+            // complete outstanding requests
+            if (!requests_->resolve(msg)) {
+                LOG_DEBUG("Discarding response to unknown request "
+                    << msg->requestId());
+            }
+            break;
+        case MessageType::DATA_REQUEST:
+            msgs.push_back(msg);
+            handleRequest(msg);
+            break;
+        case MessageType::DISCONNECT:
+            msgs.push_back(msg);
+            // fail any requests the server can no longer respond to
+            requests_->clear();
+            break;
+        default:
+            msgs.push_back(msg);
+            break;
+        }
+    }
+    auto now = Time::timestamp();
+    // fail any requests that have timed out
+    requests_->expire(now);
+    sampleStats(now);
+    return msgs;
+}
+
+void LoopbackClient::sampleStats(std::time_t now)
+{
+    if (now - lastSample_ < STATS_INTERVAL) {
+        return;
+    }
+    if (lastSample_ > 0) {
+        updateRates(stats_, last_, now - lastSample_);
+    }
+    last_ = stats_;
+    lastSample_ = now;
+}
+
+PeerStats LoopbackClient::stats() const
+{
+    return last_;
+}
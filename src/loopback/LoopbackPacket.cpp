@@ -0,0 +1,21 @@
+#include "loopback/LoopbackPacket.h"
+
+LoopbackPacket writePacket(DeliveryType type, const Message::Shared& msg)
+{
+    size_t numBytes = 0;
+    const uint8_t* data = msg->serialize(numBytes);
+    return LoopbackPacket(
+        type,
+        std::make_shared<const std::vector<uint8_t>>(data, data + numBytes));
+}
+
+Message::Shared readPacket(uint32_t peerId, const LoopbackPacket& packet)
+{
+    auto stream = StreamBuffer::alloc(
+        packet.data->data(),
+        packet.data->size(),
+        packet.data);
+    auto msg = Message::alloc(peerId);
+    msg->deserialize(stream);
+    return msg;
+}
@@ -0,0 +1,347 @@
+#include "loopback/LoopbackServer.h"
+
+#include "Common.h"
+#include "log/Log.h"
+#include "loopback/LoopbackClient.h"
+#include "time/Time.h"
+
+LoopbackServer::Shared LoopbackServer::alloc()
+{
+    return std::make_shared<LoopbackServer>();
+}
+
+LoopbackServer::LoopbackServer()
+    : running_(false)
+    , port_(0)
+    , numClients_(0)
+    , requests_(RequestTable::alloc())
+    , currentMsgId_(0)
+    , numQueued_(0)
+    , compression_(Compression::NONE)
+    , lastSample_(0)
+{
+}
+
+LoopbackServer::~LoopbackServer()
+{
+    stop();
+}
+
+bool LoopbackServer::start(uint32_t port, uint32_t maxConnections)
+{
+    if (maxConnections == 0 || maxConnections > MAX_PEER_ID + 1) {
+        LOG_ERROR("Connection limit must be between 1 and "
+            << (MAX_PEER_ID + 1)
+            << ", got "
+            << maxConnections);
+        return 1;
+    }
+    if (isRunning()) {
+        LOG_ERROR("LoopbackServer is already running");
+        return 1;
+    }
+    port_ = port;
+    peers_ = std::vector<PeerEntry>(maxConnections);
+    numClients_ = 0;
+    running_ = true;
+    return 0;
+}
+
+bool LoopbackServer::stop()
+{
+    if (!isRunning()) {
+        return 0;
+    }
+    // disconnect all clients, nothing can be lost so this always succeeds
+    LOG_DEBUG("Disconnecting " << numClients() << " clients...");
+    for (auto& entry : peers_) {
+        if (entry.client) {
+            entry.client->disconnected();
+        }
+    }
+    peers_ = std::vector<PeerEntry>();
+    numClients_ = 0;
+    received_.clear();
+    numQueued_ = 0;
+    // fail any outstanding requests
+    requests_->clear();
+    running_ = false;
+    return 0;
+}
+
+bool LoopbackServer::isRunning() const
+{
+    return running_;
+}
+
+uint32_t LoopbackServer::numClients() const
+{
+    return numClients_;
+}
+
+uint32_t LoopbackServer::port() const
+{
+    return port_;
+}
+
+bool LoopbackServer::connect(LoopbackClient* client, uint32_t& id)
+{
+    if (!isRunning()) {
+        return 1;
+    }
+    // take the lowest free id, as ENet does
+    for (uint32_t i = 0; i < peers_.size(); i++) {
+        if (!peers_[i].client) {
+            peers_[i] = PeerEntry();
+            peers_[i].client = client;
+            peers_[i].stats.id = i;
+            peers_[i].last.id = i;
+            numClients_++;
+            id = i;
+            LOG_DEBUG("Client has connected, "
+                << numClients()
+                << " connected clients");
+            received_.push_back(Message::alloc(id, MessageType::CONNECT));
+            return 0;
+        }
+    }
+    LOG_WARN("Connection refused, all "
+        << peers_.size()
+        << " connections are in use");
+    return 1;
+}
+
+void LoopbackServer::disconnect(uint32_t id)
+{
+    if (id >= peers_.size() || !peers_[id].client) {
+        return;
+    }
+    peers_[id] = PeerEntry();
+    numClients_--;
+    LOG_DEBUG("Client has disconnected, "
+        << numClients()
+        << " clients remaining");
+    received_.push_back(Message::alloc(id, MessageType::DISCONNECT));
+}
+
+void LoopbackServer::deliver(uint32_t id, const LoopbackPacket& packet)
+{
+    auto entry = getClient(id);
+    if (!entry) {
+        return;
+    }
+    auto msg = readPacket(id, packet);
+    entry->stats.messagesReceived++;
+    entry->stats.bytesReceived += packet.data->size();
+    // drop stale or out-of-order sequenced messages
+    if (packet.type == DeliveryType::SEQUENCED) {
+        if (entry->hasSequence && !isNewer(msg->id(), entry->sequence)) {
+            return;
+        }
+        entry->sequence = msg->id();
+        entry->hasSequence = true;
+    }
+    received_.push_back(msg);
+}
+
+void LoopbackServer::on(uint32_t id, RequestHandler handler)
+{
+    handlers_[id] = handler;
+}
+
+void LoopbackServer::setCompression(Compression type)
+{
+    // NOTE: there is no wire to save bytes on
+    compression_ = type;
+}
+
+CompressionStats LoopbackServer::compressionStats() const
+{
+    return CompressionStats();
+}
+
+void LoopbackServer::handleRequest(const Message::Shared& msg) const
+{
+    auto iter = handlers_.find(msg->requestId());
+    if (iter != handlers_.end()) {
+        auto handler = iter->second;
+        auto res = handler(msg->peerId(), msg->stream());
+        // respond with the id of the request message so the client can match
+        // it against its outstanding requests
+        sendResponse(msg->peerId(), msg->id(), res);
+    }
+}
+
+LoopbackServer::PeerEntry* LoopbackServer::getClient(uint32_t id) const
+{
+    if (id >= peers_.size() || !peers_[id].client) {
+        // no client to send to
+        LOG_WARN("No connected client with id: " << id);
+        return nullptr;
+    }
+    return &peers_[id];
+}
+
+void LoopbackServer::sendResponse(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream) const
+{
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        requestId, // request id
+        MessageType::DATA_RESPONSE,
+        stream);
+    sendMessage(id, DeliveryType::RELIABLE, msg);
+}
+
+void LoopbackServer::sendMessage(uint32_t id, DeliveryType type, Message::Shared msg) const
+{
+    auto entry = getClient(id);
+    if (!entry) {
+        return;
+    }
+    auto packet = writePacket(type, msg);
+    entry->stats.messagesSent++;
+    entry->stats.bytesSent += packet.data->size();
+    entry->outgoing.push_back(packet);
+    // NOTE: the packet is delivered with everything else on `flush`
+    numQueued_++;
+}
+
+void LoopbackServer::send(uint32_t id, DeliveryType type, StreamBuffer::Shared stream) const
+{
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        MessageType::DATA,
+        stream);
+    sendMessage(id, type, msg);
+}
+
+void LoopbackServer::broadcast(DeliveryType type, StreamBuffer::Shared stream) const
+{
+    if (numClients() == 0) {
+        // no clients to broadcast to
+        return;
+    }
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        MessageType::DATA,
+        stream);
+    // serialize once, every client shares the same bytes
+    auto packet = writePacket(type, msg);
+    for (auto& entry : peers_) {
+        if (entry.client) {
+            entry.stats.messagesSent++;
+            entry.stats.bytesSent += packet.data->size();
+            entry.outgoing.push_back(packet);
+        }
+    }
+    numQueued_++;
+}
+
+uint32_t LoopbackServer::sendRequest(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream) const
+{
+    auto msg = Message::alloc(
+        ++currentMsgId_, // id
+        requestId, // request id
+        MessageType::DATA_REQUEST,
+        stream);
+    sendMessage(id, DeliveryType::RELIABLE, msg);
+    return msg->id();
+}
+
+void LoopbackServer::request(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
+{
+    // NOTE: if the client is not connected the request times out
+    auto msgId = sendRequest(id, requestId, stream);
+    requests_->add(msgId, id, handler, timeout);
+}
+
+uint32_t LoopbackServer::flush()
+{
+    if (!isRunning()) {
+        return 0;
+    }
+    // hand each client everything queued for it, counting one datagram per
+    // client as ENet would coalesce them
+    uint32_t sent = 0;
+    for (auto& entry : peers_) {
+        if (entry.client && !entry.outgoing.empty()) {
+            // NOTE: swap first, delivering may queue responses
+            std::vector<LoopbackPacket> outgoing;
+            outgoing.swap(entry.outgoing);
+            for (const auto& packet : outgoing) {
+                entry.client->deliver(packet);
+            }
+            sent++;
+        }
+    }
+    numQueued_ = 0;
+    return sent;
+}
+
+uint32_t LoopbackServer::numQueued() const
+{
+    return numQueued_;
+}
+
+std::vector<Message::Shared> LoopbackServer::poll()
+{
+    std::vector<Message::Shared> msgs;
+    // NOTE: swap first, handling requests may deliver more messages
+    std::vector<Message::Shared> received;
+    received.swap(received_);
+    for (auto msg : received) {
+        switch (msg->type()) {
+        case MessageType::DATA_RESPONSE:
+            // complete outstanding requests
+            if (!requests_->resolve(msg)) {
+                LOG_DEBUG("Discarding response to unknown request "
+                    << msg->requestId());
+            }
+            break;
+        case MessageType::DATA_REQUEST:
+            msgs.push_back(msg);
+            handleRequest(msg);
+            break;
+        case MessageType::DISCONNECT:
+            msgs.push_back(msg);
+            // fail any requests the client can no longer respond to
+            requests_->cancel(msg->peerId());
+            break;
+        default:
+            msgs.push_back(msg);
+            break;
+        }
+    }
+    auto now = Time::timestamp();
+    // fail any requests that have timed out
+    requests_->expire(now);
+    sampleStats(now);
+    return msgs;
+}
+
+void LoopbackServer::sampleStats(std::time_t now)
+{
+    if (now - lastSample_ < STATS_INTERVAL) {
+        return;
+    }
+    for (auto& entry : peers_) {
+        if (entry.client) {
+            if (lastSample_ > 0) {
+                updateRates(entry.stats, entry.last, now - lastSample_);
+            }
+            entry.last = entry.stats;
+        }
+    }
+    lastSample_ = now;
+}
+
+std::vector<PeerStats> LoopbackServer::stats() const
+{
+    std::vector<PeerStats> stats;
+    for (const auto& entry : peers_) {
+        if (entry.client) {
+            stats.push_back(entry.last);
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,15 @@
+#include "net/Compression.h"
+
+bool parseCompression(const std::string& name, Compression& type)
+{
+    if (name == "none") {
+        type = Compression::NONE;
+    } else if (name == "range") {
+        type = Compression::RANGE_CODER;
+    } else if (name == "adaptive") {
+        type = Compression::ADAPTIVE;
+    } else {
+        return 1;
+    }
+    return 0;
+}
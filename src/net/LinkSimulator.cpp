@@ -0,0 +1,130 @@
+#include "net/LinkSimulator.h"
+
+#include "time/Time.h"
+
+#include <algorithm>
+
+// unreliable sends are dropped once the link is backed up by this much, as a
+// router queue would
+const std::time_t MAX_BACKLOG = 1000000;
+
+LinkSimulator::Shared LinkSimulator::alloc(const NetworkConditions& conditions)
+{
+    return std::make_shared<LinkSimulator>(conditions);
+}
+
+LinkSimulator::LinkSimulator(const NetworkConditions& conditions)
+    : conditions_(conditions)
+    , rng_(conditions.seed)
+    , order_(0)
+{
+}
+
+bool LinkSimulator::chance(float32_t probability)
+{
+    return probability > 0 && std::uniform_real_distribution<float32_t>(0, 1)(rng_) < probability;
+}
+
+std::time_t LinkSimulator::delay()
+{
+    if (conditions_.jitter == 0) {
+        return conditions_.latency;
+    }
+    std::uniform_int_distribution<std::time_t> jitter(-conditions_.jitter, conditions_.jitter);
+    return std::max(std::time_t(0), conditions_.latency + jitter(rng_));
+}
+
+void LinkSimulator::push(std::time_t release, Send send)
+{
+    Pending pending;
+    pending.release = release;
+    pending.order = order_++;
+    pending.send = send;
+    pending_.push(pending);
+}
+
+void LinkSimulator::schedule(uint32_t peer, DeliveryType type, size_t bytes, Send send)
+{
+    auto now = Time::timestamp();
+    // time on the wire for a bandwidth limited link
+    auto sent = now;
+    if (conditions_.bandwidth > 0) {
+        auto& linkFree = linkFree_[peer];
+        auto start = std::max(now, linkFree);
+        if (type != DeliveryType::RELIABLE && start - now > MAX_BACKLOG) {
+            return;
+        }
+        linkFree = start + std::time_t(bytes) * 1000000 / conditions_.bandwidth;
+        sent = linkFree;
+    }
+    switch (type) {
+    case DeliveryType::RELIABLE: {
+        auto release = sent + delay();
+        if (chance(conditions_.loss)) {
+            // resent once the loss is noticed, a round trip later
+            release += 2 * conditions_.latency;
+        }
+        // reliable sends are delivered in order
+        auto& last = reliable_[peer];
+        release = std::max(release, last);
+        last = release;
+        push(release, send);
+        break;
+    }
+    case DeliveryType::UNRELIABLE:
+        if (chance(conditions_.loss)) {
+            return;
+        }
+        // a reordered send skips the delay and overtakes the others
+        push(chance(conditions_.reorder) ? sent : sent + delay(), send);
+        if (chance(conditions_.duplicate)) {
+            push(sent + delay(), send);
+        }
+        break;
+    case DeliveryType::SEQUENCED: {
+        if (chance(conditions_.loss)) {
+            return;
+        }
+        // the receiver drops a sequenced send if a newer one arrived first
+        auto order = ++scheduled_[peer];
+        // NOTE: pending sends never outlive the simulator
+        auto sequenced = [this, send, peer, order]() {
+            auto& latest = released_[peer];
+            if (order < latest) {
+                return;
+            }
+            latest = order;
+            send();
+        };
+        push(chance(conditions_.reorder) ? sent : sent + delay(), sequenced);
+        break;
+    }
+    }
+}
+
+uint32_t LinkSimulator::release(std::time_t now)
+{
+    uint32_t count = 0;
+    while (!pending_.empty() && pending_.top().release <= now) {
+        // NOTE: copy before popping, the send may schedule more
+        auto send = pending_.top().send;
+        pending_.pop();
+        send();
+        count++;
+    }
+    return count;
+}
+
+size_t LinkSimulator::size() const
+{
+    return pending_.size();
+}
+
+void LinkSimulator::clear()
+{
+    pending_ = std::priority_queue<Pending, std::vector<Pending>, Later>();
+    linkFree_.clear();
+    reliable_.clear();
+    scheduled_.clear();
+    released_.clear();
+}
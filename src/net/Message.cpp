@@ -1,5 +1,7 @@
 #include "net/Message.h"
 
+#include <cstring>
+
 Message::Shared Message::alloc(uint32_t id, uint8_t type, StreamBuffer::Shared stream)
 {
     return std::make_shared<Message>(id, type, stream);
@@ -26,6 +28,7 @@ Message::Message(uint32_t id, uint8_t type, StreamBuffer::Shared stream)
     , requestId_(0)
     , type_(type)
     , stream_(stream)
+    , prepended_(false)
 {
 }
 
@@ -35,6 +38,7 @@ Message::Message(uint32_t id, uint32_t requestId, uint8_t type, StreamBuffer::Sh
     , requestId_(requestId)
     , type_(type)
     , stream_(stream)
+    , prepended_(false)
 {
 }
 
@@ -43,6 +47,7 @@ Message::Message(uint32_t peerId, uint8_t type)
     , peerId_(peerId)
     , requestId_(0)
     , type_(type)
+    , prepended_(false)
 {
 }
 
@@ -51,6 +56,7 @@ Message::Message(uint32_t peerId)
     , peerId_(peerId)
     , requestId_(0)
     , type_(0)
+    , prepended_(false)
 {
 }
 
@@ -79,13 +85,29 @@ StreamBuffer::Shared Message::stream() const
     return stream_;
 }
 
-std::vector<uint8_t> Message::serialize() const
+const uint8_t* Message::serialize(size_t& numBytes) const
 {
-    auto header = StreamBuffer::alloc();
-    header << id_;
-    header << requestId_;
-    header << type_;
-    return merge(header, stream_)->buffer();
+    if (!prepended_ && !framed_) {
+        auto header = StreamBuffer::alloc(MESSAGE_HEADER_SIZE, 0);
+        header << id_;
+        header << requestId_;
+        header << type_;
+        uint8_t* dst = stream_ ? stream_->prepend(MESSAGE_HEADER_SIZE) : nullptr;
+        if (dst) {
+            // write the header in front of the payload
+            std::memcpy(dst, header->data(), MESSAGE_HEADER_SIZE);
+            prepended_ = true;
+        } else {
+            // no headroom left, fall back to copying the payload
+            framed_ = merge(header, stream_);
+        }
+    }
+    if (prepended_) {
+        numBytes = MESSAGE_HEADER_SIZE + stream_->size();
+        return stream_->data() - MESSAGE_HEADER_SIZE;
+    }
+    numBytes = framed_->size();
+    return framed_->data();
 }
 
 void Message::deserialize(StreamBuffer::Shared stream)
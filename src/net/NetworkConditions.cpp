@@ -0,0 +1,45 @@
+#include "net/NetworkConditions.h"
+
+#include "log/Log.h"
+#include "time/Time.h"
+
+#include <algorithm>
+#include <sstream>
+
+bool parseConditions(const std::string& str, NetworkConditions& conditions)
+{
+    std::stringstream ss(str);
+    std::string option;
+    while (std::getline(ss, option, ',')) {
+        auto equals = option.find('=');
+        if (equals == std::string::npos) {
+            LOG_ERROR("Missing value for network condition `" << option << "`");
+            return 1;
+        }
+        auto key = option.substr(0, equals);
+        float64_t value = std::stod(option.substr(equals + 1));
+        if (value < 0) {
+            LOG_ERROR("Negative value for network condition `" << option << "`");
+            return 1;
+        }
+        if (key == "latency") {
+            conditions.latency = Time::fromMilliseconds(value);
+        } else if (key == "jitter") {
+            conditions.jitter = Time::fromMilliseconds(value);
+        } else if (key == "loss") {
+            conditions.loss = std::min(value, 100.0) / 100.0;
+        } else if (key == "duplicate") {
+            conditions.duplicate = std::min(value, 100.0) / 100.0;
+        } else if (key == "reorder") {
+            conditions.reorder = std::min(value, 100.0) / 100.0;
+        } else if (key == "bandwidth") {
+            conditions.bandwidth = value * 1000 / 8;
+        } else if (key == "seed") {
+            conditions.seed = value;
+        } else {
+            LOG_ERROR("Unknown network condition `" << key << "`");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+#include "net/PeerStats.h"
+
+#include "time/Time.h"
+
+void updateRates(PeerStats& stats, const PeerStats& last, std::time_t elapsed)
+{
+    if (elapsed <= 0) {
+        return;
+    }
+    float32_t seconds = Time::toSeconds(elapsed);
+    stats.messagesSentPerSec = (stats.messagesSent - last.messagesSent) / seconds;
+    stats.messagesReceivedPerSec = (stats.messagesReceived - last.messagesReceived) / seconds;
+    stats.bytesSentPerSec = (stats.bytesSent - last.bytesSent) / seconds;
+    stats.bytesReceivedPerSec = (stats.bytesReceived - last.bytesReceived) / seconds;
+}
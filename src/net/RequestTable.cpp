@@ -0,0 +1,96 @@
+#include "net/RequestTable.h"
+
+#include "log/Log.h"
+#include "time/Time.h"
+
+RequestTable::Shared RequestTable::alloc()
+{
+    return std::make_shared<RequestTable>();
+}
+
+RequestTable::RequestTable()
+{
+}
+
+void RequestTable::add(uint32_t id, uint32_t peerId, ResponseHandler handler, std::time_t timeout)
+{
+    Pending pending;
+    pending.peerId = peerId;
+    pending.handler = handler;
+    pending.deadline = Time::timestamp() + timeout;
+    pending_[id] = pending;
+}
+
+bool RequestTable::resolve(const Message::Shared& msg)
+{
+    auto iter = pending_.find(msg->requestId());
+    if (iter == pending_.end() || iter->second.peerId != msg->peerId()) {
+        // unknown, expired, or from the wrong peer
+        return false;
+    }
+    // remove before calling the handler in case it issues another request
+    auto handler = iter->second.handler;
+    pending_.erase(iter);
+    if (handler) {
+        handler(msg);
+    }
+    return true;
+}
+
+void RequestTable::expire(std::time_t now)
+{
+    std::vector<ResponseHandler> failed;
+    auto iter = pending_.begin();
+    while (iter != pending_.end()) {
+        if (now >= iter->second.deadline) {
+            LOG_DEBUG("Request " << iter->first << " timed out");
+            failed.push_back(iter->second.handler);
+            iter = pending_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+    for (auto handler : failed) {
+        if (handler) {
+            handler(nullptr);
+        }
+    }
+}
+
+void RequestTable::cancel(uint32_t peerId)
+{
+    std::vector<ResponseHandler> failed;
+    auto iter = pending_.begin();
+    while (iter != pending_.end()) {
+        if (iter->second.peerId == peerId) {
+            failed.push_back(iter->second.handler);
+            iter = pending_.erase(iter);
+        } else {
+            iter++;
+        }
+    }
+    for (auto handler : failed) {
+        if (handler) {
+            handler(nullptr);
+        }
+    }
+}
+
+void RequestTable::clear()
+{
+    std::vector<ResponseHandler> failed;
+    for (auto iter : pending_) {
+        failed.push_back(iter.second.handler);
+    }
+    pending_.clear();
+    for (auto handler : failed) {
+        if (handler) {
+            handler(nullptr);
+        }
+    }
+}
+
+size_t RequestTable::size() const
+{
+    return pending_.size();
+}
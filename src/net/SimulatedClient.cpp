@@ -0,0 +1,94 @@
+#include "net/SimulatedClient.h"
+
+#include "time/Time.h"
+
+// the only peer of a client
+const uint32_t SERVER_PEER = 0;
+
+static size_t messageSize(const StreamBuffer::Shared& stream)
+{
+    return MESSAGE_HEADER_SIZE + (stream ? stream->size() : 0);
+}
+
+SimulatedClient::Shared SimulatedClient::alloc(Client::Shared client, const NetworkConditions& conditions)
+{
+    return std::make_shared<SimulatedClient>(client, conditions);
+}
+
+SimulatedClient::SimulatedClient(Client::Shared client, const NetworkConditions& conditions)
+    : client_(client)
+    , link_(LinkSimulator::alloc(conditions))
+{
+}
+
+bool SimulatedClient::connect(const std::string& host, uint32_t port)
+{
+    // nothing sent on a previous connection may arrive on this one
+    link_->clear();
+    return client_->connect(host, port);
+}
+
+bool SimulatedClient::disconnect()
+{
+    // anything still on the simulated link is lost
+    link_->clear();
+    return client_->disconnect();
+}
+
+bool SimulatedClient::isConnected() const
+{
+    return client_->isConnected();
+}
+
+void SimulatedClient::send(DeliveryType type, StreamBuffer::Shared stream) const
+{
+    auto client = client_;
+    link_->schedule(SERVER_PEER, type, messageSize(stream), [client, type, stream]() {
+        client->send(type, stream);
+    });
+}
+
+uint32_t SimulatedClient::flush()
+{
+    link_->release(Time::timestamp());
+    return client_->flush();
+}
+
+uint32_t SimulatedClient::numQueued() const
+{
+    return client_->numQueued() + link_->size();
+}
+
+void SimulatedClient::request(uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
+{
+    auto client = client_;
+    link_->schedule(SERVER_PEER, DeliveryType::RELIABLE, messageSize(stream), [client, requestId, stream, handler, timeout]() {
+        client->request(requestId, stream, handler, timeout);
+    });
+}
+
+std::vector<Message::Shared> SimulatedClient::poll()
+{
+    link_->release(Time::timestamp());
+    return client_->poll();
+}
+
+void SimulatedClient::on(uint32_t id, RequestHandler handler)
+{
+    client_->on(id, handler);
+}
+
+void SimulatedClient::setCompression(Compression type)
+{
+    client_->setCompression(type);
+}
+
+CompressionStats SimulatedClient::compressionStats() const
+{
+    return client_->compressionStats();
+}
+
+PeerStats SimulatedClient::stats() const
+{
+    return client_->stats();
+}
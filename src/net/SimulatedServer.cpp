@@ -0,0 +1,105 @@
+#include "net/SimulatedServer.h"
+
+#include "time/Time.h"
+
+// key for the sends to every client
+const uint32_t BROADCAST_PEER = 0xffffffff;
+
+static size_t messageSize(const StreamBuffer::Shared& stream)
+{
+    return MESSAGE_HEADER_SIZE + (stream ? stream->size() : 0);
+}
+
+SimulatedServer::Shared SimulatedServer::alloc(Server::Shared server, const NetworkConditions& conditions)
+{
+    return std::make_shared<SimulatedServer>(server, conditions);
+}
+
+SimulatedServer::SimulatedServer(Server::Shared server, const NetworkConditions& conditions)
+    : server_(server)
+    , link_(LinkSimulator::alloc(conditions))
+{
+}
+
+bool SimulatedServer::start(uint32_t port, uint32_t maxConnections)
+{
+    return server_->start(port, maxConnections);
+}
+
+bool SimulatedServer::stop()
+{
+    // anything still on the simulated link is lost
+    link_->clear();
+    return server_->stop();
+}
+
+bool SimulatedServer::isRunning() const
+{
+    return server_->isRunning();
+}
+
+uint32_t SimulatedServer::numClients() const
+{
+    return server_->numClients();
+}
+
+void SimulatedServer::send(uint32_t id, DeliveryType type, StreamBuffer::Shared stream) const
+{
+    auto server = server_;
+    link_->schedule(id, type, messageSize(stream), [server, id, type, stream]() {
+        server->send(id, type, stream);
+    });
+}
+
+void SimulatedServer::broadcast(DeliveryType type, StreamBuffer::Shared stream) const
+{
+    auto server = server_;
+    link_->schedule(BROADCAST_PEER, type, messageSize(stream), [server, type, stream]() {
+        server->broadcast(type, stream);
+    });
+}
+
+uint32_t SimulatedServer::flush()
+{
+    link_->release(Time::timestamp());
+    return server_->flush();
+}
+
+uint32_t SimulatedServer::numQueued() const
+{
+    return server_->numQueued() + link_->size();
+}
+
+void SimulatedServer::request(uint32_t id, uint32_t requestId, StreamBuffer::Shared stream, ResponseHandler handler, std::time_t timeout)
+{
+    auto server = server_;
+    link_->schedule(id, DeliveryType::RELIABLE, messageSize(stream), [server, id, requestId, stream, handler, timeout]() {
+        server->request(id, requestId, stream, handler, timeout);
+    });
+}
+
+std::vector<Message::Shared> SimulatedServer::poll()
+{
+    link_->release(Time::timestamp());
+    return server_->poll();
+}
+
+void SimulatedServer::on(uint32_t id, RequestHandler handler)
+{
+    server_->on(id, handler);
+}
+
+void SimulatedServer::setCompression(Compression type)
+{
+    server_->setCompression(type);
+}
+
+CompressionStats SimulatedServer::compressionStats() const
+{
+    return server_->compressionStats();
+}
+
+std::vector<PeerStats> SimulatedServer::stats() const
+{
+    return server_->stats();
+}
@@ -0,0 +1,90 @@
+#include "profile/Histogram.h"
+
+#include <algorithm>
+
+// linear buckets per power of two, and values below twice that that get a
+// bucket each
+const uint32_t SUB_BUCKETS = 32;
+const uint32_t LINEAR_LIMIT = SUB_BUCKETS * 2;
+
+// enough groups for any 64 bit value
+const uint32_t NUM_BUCKETS = LINEAR_LIMIT + (64 - 6) * SUB_BUCKETS;
+
+Histogram::Histogram()
+    : counts_(NUM_BUCKETS, 0)
+    , count_(0)
+    , max_(0)
+    , total_(0)
+{
+}
+
+uint32_t Histogram::index(uint64_t value)
+{
+    if (value < LINEAR_LIMIT) {
+        return value;
+    }
+    // shift the value down until it lands in [32, 64)
+    uint32_t shift = 1;
+    while ((value >> shift) >= LINEAR_LIMIT) {
+        shift++;
+    }
+    return LINEAR_LIMIT + (shift - 1) * SUB_BUCKETS + uint32_t(value >> shift) - SUB_BUCKETS;
+}
+
+uint64_t Histogram::value(uint32_t index)
+{
+    if (index < LINEAR_LIMIT) {
+        return index;
+    }
+    uint32_t shift = (index - LINEAR_LIMIT) / SUB_BUCKETS + 1;
+    uint64_t sub = (index - LINEAR_LIMIT) % SUB_BUCKETS + SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(uint64_t value)
+{
+    counts_[index(value)]++;
+    count_++;
+    max_ = std::max(max_, value);
+    total_ += value;
+}
+
+void Histogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    max_ = 0;
+    total_ = 0;
+}
+
+uint64_t Histogram::count() const
+{
+    return count_;
+}
+
+uint64_t Histogram::max() const
+{
+    return max_;
+}
+
+float64_t Histogram::mean() const
+{
+    return count_ > 0 ? total_ / count_ : 0;
+}
+
+uint64_t Histogram::percentile(float64_t fraction) const
+{
+    if (count_ == 0) {
+        return 0;
+    }
+    // rank of the value, counting from 1
+    uint64_t rank = std::max(uint64_t(1), uint64_t(fraction * count_ + 0.5));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return std::min(value(i), max_);
+        }
+    }
+    return max_;
+}
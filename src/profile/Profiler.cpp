@@ -0,0 +1,124 @@
+#include "profile/Profiler.h"
+
+#include "log/Log.h"
+#include "time/Time.h"
+
+#include <sstream>
+
+const char* PHASE_NAMES[Phase::NUM_PHASES] = {
+    "poll",
+    "decode",
+    "input",
+    "frame",
+    "serialize",
+    "broadcast"
+};
+
+static std::string formatNanos(uint64_t nanoseconds)
+{
+    if (nanoseconds < 1000) {
+        return std::to_string(nanoseconds) + "ns";
+    }
+    return Time::format(nanoseconds / 1000);
+}
+
+static uint64_t since(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+Profiler::Shared Profiler::alloc()
+{
+    return std::make_shared<Profiler>();
+}
+
+Profiler::Profiler()
+    : started_(std::chrono::steady_clock::now())
+    , current_(Phase::NUM_PHASES, 0)
+    , last_(Phase::NUM_PHASES, 0)
+    , phases_(Phase::NUM_PHASES)
+{
+}
+
+void Profiler::add(uint8_t phase, uint64_t nanoseconds)
+{
+    current_[phase] += nanoseconds;
+}
+
+void Profiler::beginTick()
+{
+    std::fill(current_.begin(), current_.end(), 0);
+    started_ = std::chrono::steady_clock::now();
+}
+
+uint64_t Profiler::endTick()
+{
+    uint64_t duration = since(started_);
+    ticks_.record(duration);
+    for (uint32_t i = 0; i < Phase::NUM_PHASES; i++) {
+        phases_[i].record(current_[i]);
+    }
+    last_.swap(current_);
+    return duration;
+}
+
+std::string Profiler::breakdown() const
+{
+    std::ostringstream out;
+    for (uint32_t i = 0; i < Phase::NUM_PHASES; i++) {
+        if (i > 0) {
+            out << ", ";
+        }
+        out << PHASE_NAMES[i] << " " << formatNanos(last_[i]);
+    }
+    return out.str();
+}
+
+void Profiler::dump()
+{
+    LOG_INFO("Profiled "
+        << ticks_.count()
+        << " ticks, p50 "
+        << formatNanos(ticks_.percentile(0.5))
+        << ", p99 "
+        << formatNanos(ticks_.percentile(0.99))
+        << ", p999 "
+        << formatNanos(ticks_.percentile(0.999))
+        << ", max "
+        << formatNanos(ticks_.max()));
+    for (uint32_t i = 0; i < Phase::NUM_PHASES; i++) {
+        const Histogram& phase = phases_[i];
+        LOG_INFO("    "
+            << PHASE_NAMES[i]
+            << ": p50 "
+            << formatNanos(phase.percentile(0.5))
+            << ", p99 "
+            << formatNanos(phase.percentile(0.99))
+            << ", p999 "
+            << formatNanos(phase.percentile(0.999))
+            << ", max "
+            << formatNanos(phase.max())
+            << ", mean "
+            << formatNanos(phase.mean()));
+        phases_[i].reset();
+    }
+    ticks_.reset();
+}
+
+ProfileScope::ProfileScope(const Profiler::Shared& profiler, uint8_t phase)
+    : profiler_(profiler.get())
+    , phase_(phase)
+{
+    if (profiler_) {
+        start_ = std::chrono::steady_clock::now();
+    }
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (profiler_) {
+        profiler_->add(phase_, since(start_));
+    }
+}
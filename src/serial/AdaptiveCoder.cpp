@@ -0,0 +1,299 @@
+#include "serial/AdaptiveCoder.h"
+
+#include <cstring>
+
+// carryless range coder constants, after Dmitry Subbotin
+const uint32_t RANGE_TOP = 1 << 24;
+const uint32_t RANGE_BOTTOM = 1 << 16;
+
+// frequency added to a symbol each time it is coded
+const uint32_t MODEL_INCREMENT = 24;
+// the model is halved once its total would exceed this
+const uint32_t MODEL_LIMIT = RANGE_BOTTOM;
+const uint32_t NUM_SYMBOLS = 256;
+
+// byte frequencies of serialized snapshot messages, scaled to sum to roughly
+// 4096 with a floor of 1 so that every byte can be coded
+const uint16_t PRIOR[NUM_SYMBOLS] = {
+    1804, 245, 5, 18, 5, 7, 19, 5, 18, 6, 20, 6, 6, 5, 5, 9,
+    6, 4, 5, 6, 19, 4, 4, 5, 3, 5, 3, 5, 3, 4, 19, 3,
+    4, 4, 4, 6, 4, 5, 5, 4, 14, 8, 6, 4, 5, 3, 5, 4,
+    3, 4, 5, 19, 5, 4, 4, 15, 5, 4, 4, 3, 6, 18, 5, 17,
+    18, 85, 157, 4, 3, 3, 4, 17, 5, 5, 5, 3, 6, 4, 4, 3,
+    3, 16, 8, 5, 5, 3, 4, 6, 5, 4, 3, 3, 18, 3, 15, 3,
+    3, 5, 3, 4, 4, 3, 19, 4, 4, 4, 4, 5, 4, 3, 4, 17,
+    19, 5, 4, 4, 4, 6, 3, 4, 6, 4, 17, 6, 3, 5, 5, 5,
+    15, 6, 5, 5, 32, 19, 4, 6, 5, 5, 7, 4, 6, 5, 5, 18,
+    4, 4, 5, 4, 8, 5, 4, 4, 6, 21, 4, 5, 4, 4, 6, 5,
+    6, 4, 5, 18, 5, 5, 6, 5, 6, 5, 6, 5, 5, 6, 17, 3,
+    6, 4, 6, 5, 5, 5, 4, 5, 19, 3, 3, 3, 3, 5, 5, 8,
+    28, 61, 100, 4, 4, 3, 4, 5, 3, 2, 3, 2, 18, 3, 3, 2,
+    3, 4, 3, 2, 3, 3, 6, 13, 3, 2, 2, 2, 4, 2, 2, 2,
+    3, 17, 3, 2, 2, 2, 4, 2, 2, 2, 2, 17, 3, 2, 2, 2,
+    4, 2, 2, 2, 2, 16, 2, 2, 2, 2, 4, 2, 2, 2, 2, 9
+};
+
+/**
+ * Adaptive byte frequencies stored in a Fenwick tree so that cumulative
+ * frequency lookups and updates are O(log n).
+ */
+class Model {
+
+public:
+    Model()
+    {
+        // build the tree for the prior once, each buffer starts from a copy
+        static Model prior(PRIOR);
+        *this = prior;
+    }
+
+    uint32_t total() const
+    {
+        return total_;
+    }
+
+    uint32_t frequency(uint8_t symbol) const
+    {
+        return freq_[symbol];
+    }
+
+    uint32_t cumulative(uint8_t symbol) const
+    {
+        // sum of the frequencies of all symbols before this one
+        uint32_t sum = 0;
+        for (uint32_t i = symbol; i > 0; i -= i & (~i + 1)) {
+            sum += tree_[i];
+        }
+        return sum;
+    }
+
+    uint8_t find(uint32_t target, uint32_t& cumulative) const
+    {
+        // find the symbol whose cumulative range contains the target
+        uint32_t pos = 0;
+        uint32_t sum = 0;
+        for (uint32_t step = NUM_SYMBOLS; step > 0; step >>= 1) {
+            if (pos + step <= NUM_SYMBOLS && sum + tree_[pos + step] <= target) {
+                pos += step;
+                sum += tree_[pos];
+            }
+        }
+        cumulative = sum;
+        return uint8_t(pos);
+    }
+
+    void update(uint8_t symbol)
+    {
+        if (total_ + MODEL_INCREMENT > MODEL_LIMIT) {
+            rescale();
+        }
+        freq_[symbol] += MODEL_INCREMENT;
+        total_ += MODEL_INCREMENT;
+        for (uint32_t i = symbol + 1; i <= NUM_SYMBOLS; i += i & (~i + 1)) {
+            tree_[i] += MODEL_INCREMENT;
+        }
+    }
+
+private:
+    explicit Model(const uint16_t* prior)
+    {
+        for (uint32_t i = 0; i < NUM_SYMBOLS; i++) {
+            freq_[i] = prior[i] > 0 ? prior[i] : 1;
+        }
+        build();
+    }
+
+    void rescale()
+    {
+        for (uint32_t i = 0; i < NUM_SYMBOLS; i++) {
+            freq_[i] = (freq_[i] + 1) / 2;
+        }
+        build();
+    }
+
+    void build()
+    {
+        total_ = 0;
+        std::memset(tree_, 0, sizeof(tree_));
+        for (uint32_t i = 0; i < NUM_SYMBOLS; i++) {
+            total_ += freq_[i];
+            for (uint32_t j = i + 1; j <= NUM_SYMBOLS; j += j & (~j + 1)) {
+                tree_[j] += freq_[i];
+            }
+        }
+    }
+
+    uint32_t freq_[NUM_SYMBOLS];
+    // 1-indexed Fenwick tree of the frequencies
+    uint32_t tree_[NUM_SYMBOLS + 1];
+    uint32_t total_;
+};
+
+class Encoder {
+
+public:
+    Encoder(uint8_t* out, size_t limit)
+        : out_(out)
+        , limit_(limit)
+        , size_(0)
+        , low_(0)
+        , range_(0xffffffff)
+    {
+    }
+
+    void encode(uint32_t cumulative, uint32_t frequency, uint32_t total)
+    {
+        range_ /= total;
+        low_ += cumulative * range_;
+        range_ *= frequency;
+        normalize();
+    }
+
+    void flush()
+    {
+        for (uint32_t i = 0; i < 4; i++) {
+            put(low_ >> 24);
+            low_ <<= 8;
+        }
+    }
+
+    bool overflow() const
+    {
+        return size_ > limit_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+    void normalize()
+    {
+        while (true) {
+            if ((low_ ^ (low_ + range_)) >= RANGE_TOP) {
+                if (range_ >= RANGE_BOTTOM) {
+                    break;
+                }
+                // the range straddles a byte boundary but is too small, give
+                // up the bits below the boundary
+                range_ = (0 - low_) & (RANGE_BOTTOM - 1);
+            }
+            put(low_ >> 24);
+            low_ <<= 8;
+            range_ <<= 8;
+        }
+    }
+
+    void put(uint8_t byte)
+    {
+        if (size_ < limit_) {
+            out_[size_] = byte;
+        }
+        size_++;
+    }
+
+    uint8_t* out_;
+    size_t limit_;
+    size_t size_;
+    uint32_t low_;
+    uint32_t range_;
+};
+
+class Decoder {
+
+public:
+    Decoder(const uint8_t* in, size_t size)
+        : in_(in)
+        , size_(size)
+        , pos_(0)
+        , low_(0)
+        , range_(0xffffffff)
+        , code_(0)
+    {
+        for (uint32_t i = 0; i < 4; i++) {
+            code_ = (code_ << 8) | get();
+        }
+    }
+
+    uint32_t target(uint32_t total)
+    {
+        range_ /= total;
+        uint32_t value = (code_ - low_) / range_;
+        return value < total ? value : total - 1;
+    }
+
+    void decode(uint32_t cumulative, uint32_t frequency)
+    {
+        low_ += cumulative * range_;
+        range_ *= frequency;
+        while (true) {
+            if ((low_ ^ (low_ + range_)) >= RANGE_TOP) {
+                if (range_ >= RANGE_BOTTOM) {
+                    break;
+                }
+                range_ = (0 - low_) & (RANGE_BOTTOM - 1);
+            }
+            code_ = (code_ << 8) | get();
+            low_ <<= 8;
+            range_ <<= 8;
+        }
+    }
+
+private:
+    uint8_t get()
+    {
+        // the encoder flushes every byte it needs, past the end is padding
+        return pos_ < size_ ? in_[pos_++] : 0;
+    }
+
+    const uint8_t* in_;
+    size_t size_;
+    size_t pos_;
+    uint32_t low_;
+    uint32_t range_;
+    uint32_t code_;
+};
+
+size_t adaptiveCompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outLimit)
+{
+    // the decoded size is stored up front
+    if (inSize > 0xffff || outLimit < 2) {
+        return 0;
+    }
+    out[0] = uint8_t(inSize >> 8);
+    out[1] = uint8_t(inSize);
+    Encoder encoder(out + 2, outLimit - 2);
+    Model model;
+    for (size_t i = 0; i < inSize; i++) {
+        uint8_t symbol = in[i];
+        encoder.encode(model.cumulative(symbol), model.frequency(symbol), model.total());
+        model.update(symbol);
+    }
+    encoder.flush();
+    if (encoder.overflow()) {
+        return 0;
+    }
+    return 2 + encoder.size();
+}
+
+size_t adaptiveDecompress(const uint8_t* in, size_t inSize, uint8_t* out, size_t outLimit)
+{
+    if (inSize < 2) {
+        return 0;
+    }
+    size_t outSize = (size_t(in[0]) << 8) | in[1];
+    if (outSize > outLimit) {
+        return 0;
+    }
+    Decoder decoder(in + 2, inSize - 2);
+    Model model;
+    for (size_t i = 0; i < outSize; i++) {
+        uint32_t cumulative = 0;
+        uint8_t symbol = model.find(decoder.target(model.total()), cumulative);
+        decoder.decode(cumulative, model.frequency(symbol));
+        model.update(symbol);
+        out[i] = symbol;
+    }
+    return outSize;
+}
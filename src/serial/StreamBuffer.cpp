@@ -4,9 +4,9 @@
 
 #include <fstream>
 
-StreamBuffer::Shared StreamBuffer::alloc(size_t numBytes)
+StreamBuffer::Shared StreamBuffer::alloc(size_t numBytes, size_t headroom)
 {
-    return std::make_shared<StreamBuffer>(numBytes);
+    return std::make_shared<StreamBuffer>(numBytes, headroom);
 }
 
 StreamBuffer::Shared StreamBuffer::alloc(const uint8_t* data, size_t numBytes)
@@ -14,24 +14,92 @@ StreamBuffer::Shared StreamBuffer::alloc(const uint8_t* data, size_t numBytes)
     return std::make_shared<StreamBuffer>(data, numBytes);
 }
 
-StreamBuffer::StreamBuffer(size_t numBytes)
+StreamBuffer::Shared StreamBuffer::alloc(const uint8_t* data, size_t numBytes, std::shared_ptr<const void> owner)
+{
+    return std::make_shared<StreamBuffer>(data, numBytes, owner);
+}
+
+StreamBuffer::StreamBuffer(size_t numBytes, size_t headroom)
     : gpos_(0)
     , ppos_(0)
+    , begin_(headroom)
+    , headroom_(headroom)
+    , view_(nullptr)
+    , viewSize_(0)
 {
-    buffer_.reserve(numBytes);
+    buffer_.reserve(headroom + numBytes);
+    buffer_.resize(headroom, 0);
 }
 
 StreamBuffer::StreamBuffer(const uint8_t* data, size_t numBytes)
     : gpos_(0)
     , ppos_(0)
+    , begin_(0)
+    , headroom_(0)
+    , view_(nullptr)
+    , viewSize_(0)
 {
     buffer_.reserve(numBytes);
     buffer_.assign(data, data + numBytes);
 }
 
-const std::vector<uint8_t>& StreamBuffer::buffer() const
+StreamBuffer::StreamBuffer(const uint8_t* data, size_t numBytes, std::shared_ptr<const void> owner)
+    : gpos_(0)
+    , ppos_(0)
+    , begin_(0)
+    , headroom_(0)
+    , view_(data)
+    , viewSize_(numBytes)
+    , owner_(owner)
+{
+}
+
+const uint8_t* StreamBuffer::data() const
+{
+    if (view_) {
+        return view_;
+    }
+    return buffer_.data() + begin_;
+}
+
+size_t StreamBuffer::size() const
+{
+    if (view_) {
+        return viewSize_;
+    }
+    return buffer_.size() - begin_;
+}
+
+bool StreamBuffer::isView() const
+{
+    return view_ != nullptr;
+}
+
+void StreamBuffer::detach()
 {
-    return buffer_;
+    // copy the borrowed bytes so the stream can be written to, and release
+    // the owner
+    buffer_.assign(view_, view_ + viewSize_);
+    view_ = nullptr;
+    viewSize_ = 0;
+    owner_.reset();
+}
+
+size_t StreamBuffer::headroom() const
+{
+    return headroom_;
+}
+
+uint8_t* StreamBuffer::prepend(size_t numBytes)
+{
+    // claims the bytes of headroom immediately in front of the data, the
+    // headroom can only be claimed once so that two owners never write the
+    // same bytes. The data itself is unaffected.
+    if (numBytes > headroom_) {
+        return nullptr;
+    }
+    headroom_ = 0;
+    return &buffer_[begin_ - numBytes];
 }
 
 void StreamBuffer::seekg(size_t pos)
@@ -54,61 +122,81 @@ size_t StreamBuffer::tellp() const
     return ppos_;
 }
 
-size_t StreamBuffer::size() const
+bool StreamBuffer::eof() const
 {
-    return buffer_.size();
+    return gpos_ >= size();
 }
 
-bool StreamBuffer::eof() const
+size_t StreamBuffer::remaining() const
 {
-    return gpos_ >= buffer_.size();
+    if (eof()) {
+        return 0;
+    }
+    return size() - gpos_;
 }
 
-void StreamBuffer::write(bool data)
+void StreamBuffer::put(uint8_t byte)
 {
-    buffer_.push_back(data ? 1 : 0);
+    if (view_) {
+        detach();
+    }
+    // overwrite in place if the put position was moved back, otherwise append
+    size_t index = begin_ + ppos_;
+    if (index < buffer_.size()) {
+        buffer_[index] = byte;
+    } else {
+        buffer_.push_back(byte);
+    }
     ppos_++;
 }
 
+const uint8_t* StreamBuffer::get(size_t numBytes)
+{
+    // NOTE: a truncated stream reads as zeros and leaves the stream at eof,
+    // so callers only need to check eof once they are done
+    if (numBytes > remaining()) {
+        gpos_ = size();
+        return nullptr;
+    }
+    const uint8_t* b = data() + gpos_;
+    gpos_ += numBytes;
+    return b;
+}
+
+void StreamBuffer::write(bool data)
+{
+    put(data ? 1 : 0);
+}
+
 void StreamBuffer::write(uint8_t data)
 {
-    buffer_.push_back(data);
-    ppos_++;
+    put(data);
 }
 
 void StreamBuffer::write(uint16_t data)
 {
-    std::vector<uint8_t> buff(sizeof(data), 0);
-    buff[0] = data >> 8;
-    buff[1] = data;
-    buffer_.insert(buffer_.end(), buff.begin(), buff.end());
-    ppos_ += 2;
+    put(data >> 8);
+    put(data);
 }
 
 void StreamBuffer::write(uint32_t data)
 {
-    std::vector<uint8_t> buff(sizeof(data), 0);
-    buff[0] = data >> 24;
-    buff[1] = data >> 16;
-    buff[2] = data >> 8;
-    buff[3] = data;
-    buffer_.insert(buffer_.end(), buff.begin(), buff.end());
-    ppos_ += 4;
+    put(data >> 24);
+    put(data >> 16);
+    put(data >> 8);
+    put(data);
 }
 
 void StreamBuffer::write(uint64_t data)
 {
-    std::vector<uint8_t> buff(sizeof(data), 0);
-    buff[0] = data >> 56;
-    buff[1] = data >> 48;
-    buff[2] = data >> 40;
-    buff[3] = data >> 32;
-    buff[4] = data >> 24;
-    buff[5] = data >> 16;
-    buff[6] = data >> 8;
-    buff[7] = data;
-    buffer_.insert(buffer_.end(), buff.begin(), buff.end());
-    ppos_ += 8;
+    put(data >> 56);
+    put(data >> 48);
+    put(data >> 40);
+    put(data >> 32);
+    put(data >> 24);
+    put(data >> 16);
+    put(data >> 8);
+    put(data);
 }
 
 void StreamBuffer::write(float32_t data)
@@ -125,10 +213,7 @@ void StreamBuffer::write(std::string data)
 {
     auto len = data.size();
     write(uint32_t(len));
-    const char* bytes = data.c_str();
-    for (uint32_t i = 0; i < len; i++) {
-        write(uint8_t(bytes[i]));
-    }
+    write((const uint8_t*)data.c_str(), len);
 }
 
 void StreamBuffer::write(std::time_t data)
@@ -165,25 +250,48 @@ void StreamBuffer::write(const glm::quat& data)
     write(data.w);
 }
 
+void StreamBuffer::write(const uint8_t* data, size_t numBytes)
+{
+    if (view_) {
+        detach();
+    }
+    size_t index = begin_ + ppos_;
+    if (index == buffer_.size()) {
+        buffer_.insert(buffer_.end(), data, data + numBytes);
+        ppos_ += numBytes;
+        return;
+    }
+    for (size_t i = 0; i < numBytes; i++) {
+        put(data[i]);
+    }
+}
+
 void StreamBuffer::read(bool& data)
 {
-    data = buffer_[gpos_++] ? true : false;
+    const uint8_t* b = get(1);
+    data = b && b[0] ? true : false;
 }
 
 void StreamBuffer::read(uint8_t& data)
 {
-    data = buffer_[gpos_++];
+    const uint8_t* b = get(1);
+    data = b ? b[0] : 0;
 }
 
 void StreamBuffer::read(int8_t& data)
 {
-    data = buffer_[gpos_++];
+    const uint8_t* b = get(1);
+    data = b ? b[0] : 0;
 }
 
 void StreamBuffer::read(uint16_t& data)
 {
-    data = ((uint16_t)buffer_[gpos_] << 8) | buffer_[gpos_ + 1];
-    gpos_ += 2;
+    const uint8_t* b = get(2);
+    if (!b) {
+        data = 0;
+        return;
+    }
+    data = ((uint16_t)b[0] << 8) | b[1];
 }
 
 void StreamBuffer::read(int16_t& data)
@@ -200,8 +308,12 @@ void StreamBuffer::read(int16_t& data)
 
 void StreamBuffer::read(uint32_t& data)
 {
-    data = ((uint32_t)buffer_[gpos_] << 24) | ((uint32_t)buffer_[gpos_ + 1] << 16) | ((uint32_t)buffer_[gpos_ + 2] << 8) | buffer_[gpos_ + 3];
-    gpos_ += 4;
+    const uint8_t* b = get(4);
+    if (!b) {
+        data = 0;
+        return;
+    }
+    data = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
 }
 
 void StreamBuffer::read(int32_t& data)
@@ -218,8 +330,12 @@ void StreamBuffer::read(int32_t& data)
 
 void StreamBuffer::read(uint64_t& data)
 {
-    data = ((uint64_t)buffer_[gpos_] << 56) | ((uint64_t)buffer_[gpos_ + 1] << 48) | ((uint64_t)buffer_[gpos_ + 2] << 40) | ((uint64_t)buffer_[gpos_ + 3] << 32) | ((uint64_t)buffer_[gpos_ + 4] << 24) | ((uint64_t)buffer_[gpos_ + 5] << 16) | ((uint64_t)buffer_[gpos_ + 6] << 8) | buffer_[gpos_ + 7];
-    gpos_ += 8;
+    const uint8_t* b = get(8);
+    if (!b) {
+        data = 0;
+        return;
+    }
+    data = ((uint64_t)b[0] << 56) | ((uint64_t)b[1] << 48) | ((uint64_t)b[2] << 40) | ((uint64_t)b[3] << 32) | ((uint64_t)b[4] << 24) | ((uint64_t)b[5] << 16) | ((uint64_t)b[6] << 8) | b[7];
 }
 
 void StreamBuffer::read(int64_t& data)
@@ -261,11 +377,15 @@ void StreamBuffer::read(std::string& data)
 {
     uint32_t len = 0;
     read(len);
-    char* bytes = new char[len];
-    for (uint32_t i = 0; i < len; i++) {
-        read((uint8_t&)bytes[i]);
+    if (len > remaining()) {
+        LOG_ERROR("String of " << len << " bytes exceeds the "
+                               << remaining() << " bytes remaining");
+        data.clear();
+        gpos_ = size();
+        return;
     }
-    data.replace(0, len, std::string(bytes, len));
+    data.assign((const char*)(this->data() + gpos_), len);
+    gpos_ += len;
 }
 
 void StreamBuffer::read(glm::vec2& data)
@@ -299,32 +419,26 @@ void StreamBuffer::read(glm::quat& data)
 
 void StreamBuffer::writeToFile(const std::string& path) const
 {
-    const uint8_t* data = &buffer_[0];
     std::ofstream file(path, std::ios::binary);
-    file.write((const char*)(data), size());
+    file.write((const char*)(data()), size());
     file.close();
 }
 
 StreamBuffer::Shared merge(const StreamBuffer::Shared& a, const StreamBuffer::Shared& b)
 {
-    std::vector<uint8_t> abuff;
-    std::vector<uint8_t> bbuff;
-    uint32_t size = 0;
+    size_t size = 0;
     if (a) {
-        abuff = a->buffer();
-        size += abuff.size();
+        size += a->size();
     }
     if (b) {
-        bbuff = b->buffer();
-        size += bbuff.size();
+        size += b->size();
     }
-    auto bytes = std::vector<uint8_t>();
-    bytes.reserve(size);
+    auto merged = StreamBuffer::alloc(size);
     if (a) {
-        bytes.insert(bytes.end(), abuff.begin(), abuff.end());
+        merged->write(a->data(), a->size());
     }
     if (b) {
-        bytes.insert(bytes.end(), bbuff.begin(), bbuff.end());
+        merged->write(b->data(), b->size());
     }
-    return StreamBuffer::alloc(&bytes[0], bytes.size());
+    return merged;
 }
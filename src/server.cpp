@@ -1,14 +1,27 @@
 #include "Common.h"
 #include "enet/ENetServer.h"
+#include "enet/ENetShardedServer.h"
+#include "enet/StatsExporter.h"
+#include "game/ClientView.h"
 #include "game/Frame.h"
 #include "game/Game.h"
-#include "game/Player.h"
+#include "game/InputBuffer.h"
+#include "game/Interest.h"
+#include "game/PayloadType.h"
+#include "game/PlayerHistory.h"
+#include "game/Snapshot.h"
 #include "game/Terrain.h"
+#include "geometry/SpatialHash.h"
 #include "log/Log.h"
 #include "math/Transform.h"
+#include "net/Compression.h"
 #include "net/DeliveryType.h"
 #include "net/Message.h"
+#include "net/NetworkConditions.h"
+#include "net/SimulatedServer.h"
+#include "profile/Profiler.h"
 #include "serial/StreamBuffer.h"
+#include "time/TickScheduler.h"
 #include "time/Time.h"
 
 #include "glm/glm.hpp"
@@ -16,17 +29,112 @@
 #include <algorithm>
 #include <csignal>
 #include <iostream>
+#include <map>
 #include <string>
 #include <thread>
+#include <vector>
 
 const uint32_t PORT = 7000;
-
-bool quit = false;
+const uint32_t MAX_CONNECTIONS = 1024;
+
+// set from signal handlers, so only ever written as a sig_atomic_t
+volatile std::sig_atomic_t quit = false;
+// set by SIGUSR1 to log the profile
+volatile std::sig_atomic_t dumpProfile = false;
+
+// command line options
+uint32_t port = PORT;
+uint32_t maxConnections = MAX_CONNECTIONS;
+uint32_t numShards = 1;
+// simulation steps per second, and snapshots per second for clients that
+// don't ask for a rate
+uint32_t tickRate = Game::STEPS_PER_SEC;
+uint32_t sendRate = Game::SEND_RATE;
+std::time_t stepDuration = Game::STEP_DURATION;
+Compression compression = Compression::NONE;
+// where to export connection statistics, if anywhere
+std::string statsTarget;
+// impairments to apply to everything sent, if any
+bool simulate = false;
+NetworkConditions conditions;
+// whether to time the phases of each tick, and seconds between logging them
+bool profile = false;
+std::time_t profileInterval = 0;
 
 Server::Shared server;
+TickScheduler::Shared scheduler;
+Profiler::Shared profiler;
 Frame::Shared frame;
 Terrain::Shared terrain;
 Environment::Shared environment;
+std::map<uint32_t, ClientView::Shared> views;
+// views due a snapshot this step
+std::vector<ClientView::Shared> due;
+SpatialHash::Shared spatialIndex;
+// recent player transforms, to rewind queries to what a client saw
+PlayerHistory::Shared history;
+
+const Interest INTEREST(
+    Game::INTEREST_RADIUS,
+    Game::INTEREST_NEAR_RADIUS,
+    Game::INTEREST_FAR_INTERVAL);
+
+bool parse_args(int32_t argc, char** argv)
+{
+    for (int32_t i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            LOG_ERROR("Missing value for argument `" << arg << "`");
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--port") {
+            port = std::stoul(value);
+        } else if (arg == "--max-connections") {
+            maxConnections = std::stoul(value);
+        } else if (arg == "--shards") {
+            auto shards = std::max(1ul, std::stoul(value));
+            // every shard owns a range of client ids, they must stay below
+            // the ids of the npcs
+            if (shards > Game::NPC_ID_OFFSET / SHARD_ID_STRIDE) {
+                LOG_ERROR("Shard count must be at most " << Game::NPC_ID_OFFSET / SHARD_ID_STRIDE);
+                return 1;
+            }
+            numShards = shards;
+        } else if (arg == "--tick-rate") {
+            tickRate = std::stoul(value);
+            if (tickRate == 0) {
+                LOG_ERROR("Tick rate must be at least 1Hz");
+                return 1;
+            }
+        } else if (arg == "--send-rate") {
+            sendRate = std::stoul(value);
+            if (sendRate == 0) {
+                LOG_ERROR("Send rate must be at least 1Hz");
+                return 1;
+            }
+        } else if (arg == "--compression") {
+            if (parseCompression(value, compression)) {
+                LOG_ERROR("Unknown compression `" << value << "`");
+                return 1;
+            }
+        } else if (arg == "--stats") {
+            statsTarget = value;
+        } else if (arg == "--simulate") {
+            if (parseConditions(value, conditions)) {
+                return 1;
+            }
+            simulate = true;
+        } else if (arg == "--profile") {
+            profileInterval = Time::fromSeconds(std::stod(value));
+            profile = true;
+        } else {
+            LOG_ERROR("Unknown argument `" << arg << "`");
+            return 1;
+        }
+    }
+    return 0;
+}
 
 void signal_handler(int32_t signal)
 {
@@ -34,26 +142,111 @@ void signal_handler(int32_t signal)
     quit = true;
 }
 
-void process_input(Player::Shared player, Input::Shared input)
+void profile_handler(int32_t signal)
 {
-    player->state()->handleInput(input);
+    dumpProfile = true;
 }
 
-StreamBuffer::Shared serialize_frame(const Frame::Shared& frame)
+void process_input(int32_t index, Input::Shared input)
 {
-    auto stream = StreamBuffer::alloc();
-    stream << frame;
-    return stream;
+    if (index < 0) {
+        return;
+    }
+    frame->handleInput(index, input);
+}
+
+void process_inputs(uint32_t id, StreamBuffer::Shared stream)
+{
+    auto view = get(views, id);
+    if (!view) {
+        return;
+    }
+    int32_t index = frame->find(id);
+    // batches overlap, only apply the inputs not seen before
+    std::time_t viewTime = 0;
+    bool accepted = false;
+    std::vector<std::pair<uint32_t, Input::Shared> > inputs;
+    {
+        ProfileScope scope(profiler, Phase::DECODE);
+        inputs = deserializeInputs(stream, viewTime);
+    }
+    for (const auto& iter : inputs) {
+        if (view->acceptInput(iter.first)) {
+            ProfileScope scope(profiler, Phase::INPUT);
+            process_input(index, iter.second);
+            accepted = true;
+        }
+    }
+    if (accepted) {
+        // queries for the inputs are run against what the client saw, no
+        // further back than the history goes
+        view->setViewTime(std::max(history->oldest(), std::min(history->newest(), viewTime)));
+    }
+}
+
+uint32_t deserialize_ack(StreamBuffer::Shared stream)
+{
+    uint32_t id = 0;
+    stream >> id;
+    return id;
+}
+
+void send_snapshots(const Frame::Shared& frame, std::time_t now)
+{
+    // each client is sent at its own rate, most steps only some are due
+    due.clear();
+    for (auto iter : views) {
+        if (iter.second->due(now)) {
+            due.push_back(iter.second);
+        }
+    }
+    if (due.empty()) {
+        return;
+    }
+    Snapshot::Shared snapshot;
+    {
+        ProfileScope scope(profiler, Phase::SERIALIZE);
+        // each view numbers the snapshots it sends
+        snapshot = Snapshot::alloc(0, frame);
+        // index the player slots by position for the area of interest queries
+        spatialIndex->clear();
+        const auto& translations = snapshot->translations();
+        for (uint32_t i = 0; i < translations.size(); i++) {
+            spatialIndex->insert(i, translations[i]);
+        }
+    }
+    // send each client the relevant players as a delta against its last
+    // acknowledged snapshot
+    for (auto view : due) {
+        StreamBuffer::Shared stream;
+        {
+            ProfileScope scope(profiler, Phase::SERIALIZE);
+            stream = view->serialize(view->relevant(snapshot, spatialIndex));
+        }
+        ProfileScope scope(profiler, Phase::BROADCAST);
+        server->send(view->id(), DeliveryType::SEQUENCED, stream);
+    }
+}
+
+void adapt_send_rates()
+{
+    for (auto iter : views) {
+        iter.second->adaptSendRate();
+    }
 }
 
-Input::Shared deserialize_input(StreamBuffer::Shared stream)
+void adapt_budgets()
 {
-    auto input = Input::alloc(0);
-    stream >> input;
-    return input;
+    // the stats are sampled as often as this is called
+    for (const auto& stats : server->stats()) {
+        auto iter = views.find(stats.id);
+        if (iter != views.end()) {
+            iter->second->adaptBudget(stats);
+        }
+    }
 }
 
-void process_frame(const Frame::Shared& frame, std::time_t now, std::time_t last)
+void process_frame(const Frame::Shared& frame, std::time_t now, std::time_t dt)
 {
     auto pi2 = 2.0 * M_PI;
     auto rfactor = Time::toSeconds(now) * 0.5;
@@ -61,24 +254,40 @@ void process_frame(const Frame::Shared& frame, std::time_t now, std::time_t last
     auto angle = std::fmod(rfactor * pi2, pi2);
     auto translation = glm::vec3(std::sin(std::fmod(tfactor * pi2, pi2)) * 8.0, 0, 5.0);
     // LOG_DEBUG("Setting angle to: " << angle << " radians for time of: " << now);
-    auto axis = glm::vec3(1, 1, 1);
-    for (auto iter : frame->players()) {
-        auto id = iter.first;
-        auto player = iter.second;
-        if (id > server->numClients()) {
-            // rotate and translate non-clients
-            player->transform()->setRotation(angle, axis);
-            player->moveAlong(translation - player->transform()->translation(), environment);
-        }
-        // update player state
-        player->update(environment, now - last);
+    auto rotation = glm::angleAxis(float32_t(angle), glm::normalize(glm::vec3(1, 1, 1)));
+    // ids are in order, so the non-clients are at the end
+    const auto& ids = frame->ids();
+    for (uint32_t i = ids.size(); i > 0 && ids[i - 1] >= Game::NPC_ID_OFFSET; i--) {
+        // rotate and translate non-clients
+        frame->setRotation(i - 1, rotation);
+        frame->moveAlong(i - 1, translation - frame->translations()[i - 1], environment);
     }
+    // update player states
+    frame->update(environment, dt);
 }
 
 StreamBuffer::Shared send_client_info(uint32_t id, StreamBuffer::Shared req)
 {
+    auto view = get(views, id);
+    if (view && req && !req->eof()) {
+        // the client asks for a snapshot rate, no faster than we step
+        uint32_t rate = 0;
+        req >> rate;
+        view->setSendRate(std::min(tickRate, std::max(1u, rate)));
+    }
     auto stream = StreamBuffer::alloc();
     stream << id;
+    stream << tickRate;
+    stream << (view ? view->sendRate() : std::min(tickRate, sendRate));
+    return stream;
+}
+
+StreamBuffer::Shared send_time(uint32_t id, StreamBuffer::Shared req)
+{
+    // the client brackets this with its own send and receive times, on the
+    // same clock the frames are stamped with
+    auto stream = StreamBuffer::alloc();
+    stream << scheduler->now();
     return stream;
 }
 
@@ -98,35 +307,107 @@ void load_environment()
 int main(int argc, char** argv)
 {
 
+    if (parse_args(argc, argv)) {
+        LOG_INFO("Usage: server [--port N] [--max-connections N] [--shards N] [--tick-rate HZ] [--send-rate HZ] [--compression none|range|adaptive] [--stats file:PATH|udp:HOST:PORT] [--simulate latency=MS,jitter=MS,loss=%,duplicate=%,reorder=%,bandwidth=KBPS,seed=N] [--profile SECONDS]");
+        return 1;
+    }
+
     std::srand(std::time(0));
 
     std::signal(SIGINT, signal_handler);
     std::signal(SIGQUIT, signal_handler);
     std::signal(SIGTERM, signal_handler);
 
+    if (profile) {
+        // SIGUSR1 logs the profile on demand, an interval of 0 only does so
+        profiler = Profiler::alloc();
+        std::signal(SIGUSR1, profile_handler);
+    }
+
+    stepDuration = Time::fromRate(tickRate);
+    sendRate = std::min(tickRate, sendRate);
+
     load_environment();
 
     frame = Frame::alloc();
+    spatialIndex = SpatialHash::alloc(INTEREST.nearRadius);
+    // every client plus the npc, for each tick of the history
+    history = PlayerHistory::alloc(
+        Game::LAG_COMPENSATION_HISTORY / stepDuration + 1,
+        maxConnections + 1);
+    LOG_INFO("Reserved "
+        << history->size()
+        << " bytes for "
+        << Time::format(Game::LAG_COMPENSATION_HISTORY)
+        << " of player history");
     // TEMP: high enough ID not to conflict with a client id
-    uint32_t fakeID = 256;
-    frame->addPlayer(fakeID, Player::alloc(fakeID));
-
-    server = ENetServer::alloc();
+    uint32_t fakeID = Game::NPC_ID_OFFSET;
+    frame->add(fakeID);
+
+    if (numShards > 1) {
+        // one host per port, each serviced by its own thread
+        server = ENetShardedServer::alloc(numShards);
+    } else {
+        // service the network on its own thread so packets are read as they
+        // arrive rather than once per tick
+        server = ENetServer::alloc(true);
+    }
+    if (simulate) {
+        // impair everything the server sends
+        server = SimulatedServer::alloc(server, conditions);
+    }
     server->on(Net::CLIENT_INFO, send_client_info);
-    if (server->start(PORT)) {
+    server->on(Net::TIME_SYNC, send_time);
+    server->setCompression(compression);
+    if (server->start(port, maxConnections)) {
         return 1;
     }
 
-    std::time_t last = Time::timestamp();
-
-    auto frameCount = 0;
-
-    while (true) {
+    StatsExporter::Shared exporter;
+    if (!statsTarget.empty()) {
+        exporter = StatsExporter::alloc();
+        if (exporter->open(statsTarget)) {
+            return 1;
+        }
+    }
 
-        std::time_t now = Time::timestamp();
+    scheduler = TickScheduler::alloc(stepDuration);
+
+    std::time_t lastReport = scheduler->time();
+    std::time_t maxElapsed = 0;
+    std::time_t maxLateness = 0;
+    uint64_t lastOverruns = 0;
+    uint64_t lastDropped = 0;
+    uint32_t numMessages = 0;
+    uint32_t numDatagrams = 0;
+    CompressionStats lastStats;
+    std::time_t lastProfile = lastReport;
+
+    while (!quit) {
+
+        // wait for the next step, more than one if the last tick overran
+        uint32_t steps = scheduler->wait();
+        std::time_t started = Time::monotonic();
+        if (steps > 1) {
+            LOG_WARN("Tick "
+                << scheduler->tick()
+                << " overran by "
+                << Time::format(scheduler->lateness())
+                << ", running "
+                << steps
+                << " steps to catch up");
+        }
+        maxLateness = std::max(maxLateness, scheduler->lateness());
+        if (profiler) {
+            profiler->beginTick();
+        }
 
         // poll for events
-        auto messages = server->poll();
+        std::vector<Message::Shared> messages;
+        {
+            ProfileScope scope(profiler, Phase::POLL);
+            messages = server->poll();
+        }
 
         // process events
         for (auto msg : messages) {
@@ -137,55 +418,134 @@ int main(int argc, char** argv)
 
             case MessageType::CONNECT:
                 LOG_DEBUG("Connection from client_" << id << " received");
-                frame->addPlayer(id, Player::alloc(id));
+                frame->add(id);
+                views[id] = ClientView::alloc(id, INTEREST);
+                views[id]->setSendRate(sendRate);
                 break;
 
             case MessageType::DISCONNECT:
 
                 LOG_DEBUG("Connection from client_" << id << " lost");
-                frame->removePlayer(id);
+                frame->remove(id);
+                views.erase(id);
                 break;
 
             case MessageType::DATA:
 
-                LOG_DEBUG("Message received from client `" << id << "`");
-                auto input = deserialize_input(msg->stream());
-                auto players = frame->players();
-                auto player = players[id];
-                process_input(player, input);
+                auto stream = msg->stream();
+                uint8_t type = 0;
+                stream >> type;
+
+                switch (type) {
+
+                case PayloadType::INPUT:
+                    process_inputs(id, stream);
+                    break;
+
+                case PayloadType::SNAPSHOT_ACK:
+                    auto view = get(views, id);
+                    if (view) {
+                        view->ack(deserialize_ack(stream));
+                    }
+                    break;
+                }
                 break;
             }
         }
 
-        // process the frame
-        process_frame(frame, now, last);
+        // run the steps at their scheduled times with a fixed duration, so
+        // a stream of inputs always plays out the same
+        std::time_t now = scheduler->time();
+        {
+            ProfileScope scope(profiler, Phase::FRAME);
+            for (uint32_t i = steps; i > 0; i--) {
+                std::time_t time = now - (i - 1) * stepDuration;
 
-        // update frame timestmap
-        frame->setTimestamp(now);
+                // process the frame
+                process_frame(frame, time, stepDuration);
 
-        // broadcast frame to all clients
-        server->broadcast(DeliveryType::RELIABLE, serialize_frame(frame));
+                // update frame timestmap
+                frame->setTimestamp(time);
 
-        // check if exit
-        if (quit) {
-            break;
+                // remember where everyone was this step
+                history->record(frame);
+            }
         }
 
-        // determine elapsed frame time to calc sleep for next frame
-        std::time_t elapsed = Time::timestamp() - now;
+        // send frame snapshot to the clients that are due one
+        send_snapshots(frame, now);
 
-        // sleep until next frame step
-        if (elapsed < Game::STEP_DURATION) {
-            Time::sleep(Game::STEP_DURATION - elapsed);
+        // send everything queued this tick at once
+        numMessages += server->numQueued();
+        {
+            ProfileScope scope(profiler, Phase::BROADCAST);
+            numDatagrams += server->flush();
         }
 
-        // debug
-        if (frameCount % Game::STEPS_PER_SEC == 0) {
-            LOG_INFO("Tick of " << Time::format(now - last) << " processed in " << Time::format(elapsed));
+        maxElapsed = std::max(maxElapsed, Time::monotonic() - started);
+
+        if (profiler) {
+            // break down any tick that ran over its budget
+            uint64_t duration = profiler->endTick();
+            if (duration > uint64_t(stepDuration) * 1000) {
+                LOG_WARN("Tick "
+                    << scheduler->tick()
+                    << " took "
+                    << Time::format(duration / 1000)
+                    << ": "
+                    << profiler->breakdown());
+            }
+            if (dumpProfile || (profileInterval > 0 && now - lastProfile >= profileInterval)) {
+                profiler->dump();
+                dumpProfile = false;
+                lastProfile = now;
+            }
         }
 
-        last = now;
-        frameCount++;
+        // debug
+        if (now - lastReport >= Time::fromSeconds(1)) {
+            // slow clients get fewer snapshots, congested ones smaller ones
+            adapt_send_rates();
+            adapt_budgets();
+            LOG_INFO("Ticks of "
+                << Time::format(stepDuration)
+                << " processed in up to "
+                << Time::format(maxElapsed)
+                << ", woke up to "
+                << Time::format(maxLateness)
+                << " late");
+            if (scheduler->overruns() != lastOverruns) {
+                LOG_WARN(scheduler->overruns() - lastOverruns
+                    << " ticks overran, "
+                    << scheduler->dropped() - lastDropped
+                    << " steps dropped");
+            }
+            LOG_INFO("Sent " << numMessages << " messages in " << numDatagrams << " datagrams");
+            lastReport = now;
+            maxElapsed = 0;
+            maxLateness = 0;
+            lastOverruns = scheduler->overruns();
+            lastDropped = scheduler->dropped();
+            numMessages = 0;
+            numDatagrams = 0;
+            // bytes on the wire against the time spent compressing them
+            auto stats = server->compressionStats();
+            auto bytesIn = stats.bytesIn - lastStats.bytesIn;
+            auto bytesOut = stats.bytesOut - lastStats.bytesOut;
+            LOG_INFO("Compressed "
+                << bytesIn
+                << " bytes to "
+                << bytesOut
+                << " ("
+                << (bytesIn > 0 ? 100 * bytesOut / bytesIn : 100)
+                << "%) in "
+                << Time::format(stats.compressTime - lastStats.compressTime));
+            lastStats = stats;
+            if (exporter) {
+                exporter->write(now, server->stats());
+                exporter->write(now, stats);
+            }
+        }
     }
 
     // stop server and disconnect all clients
@@ -0,0 +1,147 @@
+#include "time/ClockSync.h"
+
+#include "game/Game.h"
+#include "log/Log.h"
+#include "time/Time.h"
+
+#include <algorithm>
+#include <cmath>
+
+// fraction of the error corrected by each sample
+const float64_t OFFSET_SMOOTHING = 0.2;
+
+// number of updates the drift is fit over, a short baseline is all noise
+const uint32_t DRIFT_HISTORY = 64;
+
+// errors larger than this are stepped to rather than slewed
+const std::time_t MAX_SLEW = Time::fromMilliseconds(250);
+
+// drift beyond this is noise, crystal oscillators are within ~100ppm
+const float64_t MAX_DRIFT = 0.0005;
+
+ClockSync::Shared ClockSync::alloc()
+{
+    return std::make_shared<ClockSync>();
+}
+
+ClockSync::ClockSync()
+    : offset_(0)
+    , drift_(0)
+    , updated_(0)
+    , roundTripTime_(0)
+    , hasOffset_(false)
+{
+}
+
+void ClockSync::add(std::time_t sent, std::time_t server, std::time_t received)
+{
+    if (received < sent) {
+        // the local clock was set back in between
+        return;
+    }
+    // assume the request and response took equally long
+    samples_.push_back(Sample(received - sent, server - (sent + received) / 2, received));
+    if (samples_.size() > Game::CLOCK_SYNC_SAMPLES) {
+        samples_.pop_front();
+    }
+    auto best = *std::min_element(samples_.begin(), samples_.end(), [](const Sample& a, const Sample& b) {
+        return a.roundTripTime < b.roundTripTime;
+    });
+    roundTripTime_ = best.roundTripTime;
+    // the best sample may be old, carry it forward by the drift
+    float64_t measured = best.offset + drift_ * (received - best.received);
+    if (!hasOffset_) {
+        offset_ = measured;
+        updated_ = received;
+        hasOffset_ = true;
+        return;
+    }
+    float64_t predicted = offset(received);
+    float64_t error = measured - predicted;
+    if (std::abs(error) > MAX_SLEW) {
+        // too far out to slew, one of the clocks has been set
+        LOG_WARN("Server clock moved by " << Time::format(std::abs(error)) << ", resynchronizing");
+        offset_ = measured;
+        drift_ = 0;
+        history_.clear();
+        updated_ = received;
+        return;
+    }
+    offset_ = predicted + OFFSET_SMOOTHING * error;
+    updated_ = received;
+    history_.push_back(std::make_pair(received, float64_t(best.offset)));
+    if (history_.size() > DRIFT_HISTORY) {
+        history_.pop_front();
+    }
+    updateDrift();
+}
+
+void ClockSync::updateDrift()
+{
+    // least squares slope of the trusted offsets, relative to the oldest to
+    // keep the sums small
+    if (history_.size() < DRIFT_HISTORY / 2) {
+        return;
+    }
+    auto origin = history_.front();
+    float64_t n = history_.size();
+    float64_t sumX = 0;
+    float64_t sumY = 0;
+    float64_t sumXX = 0;
+    float64_t sumXY = 0;
+    for (const auto& iter : history_) {
+        float64_t x = iter.first - origin.first;
+        float64_t y = iter.second - origin.second;
+        sumX += x;
+        sumY += y;
+        sumXX += x * x;
+        sumXY += x * y;
+    }
+    float64_t denom = n * sumXX - sumX * sumX;
+    if (denom <= 0) {
+        return;
+    }
+    drift_ = (n * sumXY - sumX * sumY) / denom;
+    drift_ = std::max(-MAX_DRIFT, std::min(MAX_DRIFT, drift_));
+}
+
+bool ClockSync::synced() const
+{
+    return hasOffset_ && samples_.size() >= Game::CLOCK_SYNC_MIN_SAMPLES;
+}
+
+uint32_t ClockSync::numSamples() const
+{
+    return samples_.size();
+}
+
+void ClockSync::clear()
+{
+    samples_.clear();
+    history_.clear();
+    offset_ = 0;
+    drift_ = 0;
+    updated_ = 0;
+    roundTripTime_ = 0;
+    hasOffset_ = false;
+}
+
+std::time_t ClockSync::offset(std::time_t local) const
+{
+    return offset_ + drift_ * (local - updated_);
+}
+
+std::time_t ClockSync::serverTime(std::time_t local) const
+{
+    return local + offset(local);
+}
+
+std::time_t ClockSync::roundTripTime() const
+{
+    return roundTripTime_;
+}
+
+float64_t ClockSync::drift() const
+{
+    return drift_;
+}
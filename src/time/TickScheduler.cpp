@@ -0,0 +1,91 @@
+#include "time/TickScheduler.h"
+
+#include "time/Time.h"
+
+#include <algorithm>
+#include <thread>
+
+// time before a step is due to stop sleeping and start spinning, comfortably
+// more than the usual timer slack
+const std::time_t SPIN_DURATION = 1000;
+
+// most steps owed at once, the rest are dropped rather than run back to back
+const uint32_t MAX_CATCH_UP = 5;
+
+TickScheduler::Shared TickScheduler::alloc(std::time_t stepDuration)
+{
+    return std::make_shared<TickScheduler>(stepDuration);
+}
+
+TickScheduler::TickScheduler(std::time_t stepDuration)
+    : stepDuration_(std::max(std::time_t(1), stepDuration))
+    , start_(Time::timestamp())
+    , monotonicStart_(Time::monotonic())
+    , next_(stepDuration_)
+    , tick_(0)
+    , lateness_(0)
+    , overruns_(0)
+    , dropped_(0)
+{
+}
+
+uint32_t TickScheduler::wait()
+{
+    auto elapsed = Time::monotonic() - monotonicStart_;
+    if (next_ - elapsed > SPIN_DURATION) {
+        Time::sleep(next_ - elapsed - SPIN_DURATION);
+    }
+    while ((elapsed = Time::monotonic() - monotonicStart_) < next_) {
+        std::this_thread::yield();
+    }
+    lateness_ = elapsed - next_;
+    // the step that was due plus any that have come due since
+    uint32_t steps = 1 + lateness_ / stepDuration_;
+    if (steps > 1) {
+        overruns_++;
+    }
+    if (steps > MAX_CATCH_UP) {
+        dropped_ += steps - MAX_CATCH_UP;
+        // skip the schedule ahead rather than owing the steps forever
+        next_ += (steps - MAX_CATCH_UP) * stepDuration_;
+        steps = MAX_CATCH_UP;
+    }
+    next_ += steps * stepDuration_;
+    tick_ += steps;
+    return steps;
+}
+
+std::time_t TickScheduler::stepDuration() const
+{
+    return stepDuration_;
+}
+
+uint64_t TickScheduler::tick() const
+{
+    return tick_;
+}
+
+std::time_t TickScheduler::time() const
+{
+    return start_ + (next_ - stepDuration_);
+}
+
+std::time_t TickScheduler::now() const
+{
+    return start_ + (Time::monotonic() - monotonicStart_);
+}
+
+std::time_t TickScheduler::lateness() const
+{
+    return lateness_;
+}
+
+uint64_t TickScheduler::overruns() const
+{
+    return overruns_;
+}
+
+uint64_t TickScheduler::dropped() const
+{
+    return dropped_;
+}
@@ -19,6 +19,13 @@ std::time_t timestamp()
         .count();
 }
 
+std::time_t monotonic()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
 void sleep(std::time_t duration)
 {
     std::this_thread::sleep_for(std::chrono::microseconds(duration));
@@ -39,6 +46,11 @@ std::time_t fromMilliseconds(float64_t milliseconds)
     return milliseconds * 1000;
 }
 
+std::time_t fromRate(float64_t hertz)
+{
+    return fromSeconds(1) / hertz;
+}
+
 float64_t toMinutes(std::time_t t)
 {
     return t / (1000000.0 * 60.0);